@@ -0,0 +1,198 @@
+#include "stm32f030x6.h"
+#include "tb6612.h"
+#include "param.h"
+#include "config.h"
+#include "boot.h"
+#include "proto.h"
+
+/*
+ * I2C bootloader, first 2K of flash.
+ *
+ * After a reset it starts the application if its CRC matches, unless the
+ * application asked for the bootloader with Boot_Enter(). Otherwise it
+ * answers at the application's I2C address and runs the commands in
+ * proto.c, polled, without interrupts. A read returns the status of the
+ * last command and its value, least significant byte first. After run
+ * has been acknowledged by that read the MCU resets into the image.
+ */
+
+#define I2C_BASE_ADDR           0x2d
+#define I2C_TIMEOUT_MS          10
+
+static uint8_t rx[BOOT_FRAME];
+static uint8_t reply[5];
+static uint8_t run;
+
+uint32_t boot_crc(const uint32_t *data, uint32_t words)
+{
+    CRC->CR = CRC_CR_RESET;
+    while (words--)
+        CRC->DR = *data++;
+    return CRC->DR;
+}
+
+static int flash_wait(void)
+{
+    uint32_t sr;
+
+    while (FLASH->SR & FLASH_SR_BSY);
+    sr = FLASH->SR;
+    FLASH->SR = FLASH_SR_EOP | FLASH_SR_PGERR | FLASH_SR_WRPRTERR;
+    return (sr & (FLASH_SR_PGERR | FLASH_SR_WRPRTERR)) ? -1 : 0;
+}
+
+int boot_flash_page(uint8_t page, const uint32_t *data)
+{
+    uint32_t addr = APP_BASE + (uint32_t)page * FLASH_PAGE;
+    const uint16_t *src = (const uint16_t *)data;
+    uint16_t i;
+    int rc;
+
+    FLASH->KEYR = FLASH_KEY1;
+    FLASH->KEYR = FLASH_KEY2;
+
+    FLASH->CR = FLASH_CR_PER;
+    FLASH->AR = addr;
+    FLASH->CR = FLASH_CR_PER | FLASH_CR_STRT;
+    rc = flash_wait();
+
+    FLASH->CR = FLASH_CR_PG;
+    for (i = 0; i < FLASH_PAGE / 2 && rc == 0; i++)
+    {
+        ((volatile uint16_t *)addr)[i] = src[i];
+        rc = flash_wait();
+    }
+
+    FLASH->CR = FLASH_CR_LOCK;
+    return rc;
+}
+
+const uint32_t *boot_app(void)
+{
+    return (const uint32_t *)APP_BASE;
+}
+
+void boot_run(void)
+{
+    run = 1;
+}
+
+/* a board param of the stored configuration, see config.c */
+static uint8_t config_param(uint16_t key)
+{
+    uint32_t page = CONFIG_BASE, addr;
+    uint8_t value = 0;
+
+    if (*(uint16_t *)(page + 2) != CONFIG_MAGIC ||
+        (*(uint16_t *)(page + FLASH_PAGE + 2) == CONFIG_MAGIC &&
+         (int16_t)(*(uint16_t *)(page + FLASH_PAGE) - *(uint16_t *)page) > 0))
+        page += FLASH_PAGE;
+    if (*(uint16_t *)(page + 2) != CONFIG_MAGIC)
+        return 0;
+
+    for (addr = page + 4; addr < page + FLASH_PAGE; addr += 4)
+        if (*(uint16_t *)addr == key)
+            value = *(uint16_t *)(addr + 2);
+    return value;
+}
+
+/* counts down on each SysTick wrap, 0 when expired */
+static uint8_t expired(uint8_t *ms)
+{
+    if (SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk)
+        (*ms)--;
+    return *ms == 0;
+}
+
+static void transfer(void)
+{
+    uint8_t ms = I2C_TIMEOUT_MS;
+    uint16_t len = 0;
+    uint32_t value;
+    uint8_t i;
+
+    I2C1->ICR = I2C_ICR_ADDRCF;
+
+    if (I2C1->ISR & I2C_ISR_DIR) {
+        I2C1->ISR = I2C_ISR_TXE;
+        i = 0;
+        while ((I2C1->ISR & I2C_ISR_STOPF) == 0 && !expired(&ms)) {
+            if (I2C1->ISR & I2C_ISR_TXIS)
+                I2C1->TXDR = i < sizeof(reply) ? reply[i++] : 0xff;
+        }
+        I2C1->ICR = I2C_ICR_STOPCF | I2C_ICR_NACKCF;
+        if (run)
+            NVIC_SystemReset();
+        return;
+    }
+
+    while ((I2C1->ISR & I2C_ISR_STOPF) == 0 && !expired(&ms)) {
+        if (I2C1->ISR & I2C_ISR_RXNE) {
+            uint8_t b = I2C1->RXDR;
+            if (len < sizeof(rx))
+                rx[len++] = b;
+        }
+    }
+    if ((I2C1->ISR & I2C_ISR_STOPF) == 0)
+        return;
+    if ((I2C1->ISR & I2C_ISR_RXNE) && len < sizeof(rx))
+        rx[len++] = I2C1->RXDR;
+    I2C1->ICR = I2C_ICR_STOPCF;
+
+    reply[0] = Boot_Command(rx, len, &value);
+    reply[1] = value;
+    reply[2] = value >> 8;
+    reply[3] = value >> 16;
+    reply[4] = value >> 24;
+}
+
+static void start_app(void)
+{
+    const uint32_t *vec = (const uint32_t *)APP_BASE;
+
+    __set_MSP(vec[0]);
+    ((void (*)(void))vec[1])();
+}
+
+int main()
+{
+    volatile uint32_t *flag = (uint32_t *)BOOT_FLAG_ADDR;
+    uint8_t addr, straps;
+
+    RCC->AHBENR |= RCC_AHBENR_CRCEN;
+    if ((*flag != BOOT_MAGIC || (RCC->CSR & RCC_CSR_PORRSTF)) && Boot_Image_Valid())
+        start_app();
+    *flag = 0;
+
+    RCC->AHBENR |= RCC_AHBENR_GPIOAEN | RCC_AHBENR_GPIOFEN;
+    RCC->APB1ENR |= RCC_APB1ENR_I2C1EN;
+
+    GPIOA->MODER |= MODER(MODE_AF, PIN_SCL) | MODER(MODE_AF, PIN_SDA);
+    GPIOA->AFR[1] |= (4 << GPIO_AFRH_AFRH1_Pos) | (4 << GPIO_AFRH_AFRH2_Pos);
+    GPIOA->OTYPER |= GPIO_OTYPER_OT_9 | GPIO_OTYPER_OT_10;
+    GPIOA->PUPDR |= GPIO_PUPDR_PUPDR9_0 | GPIO_PUPDR_PUPDR10_0;
+
+    GPIOF->PUPDR |= GPIO_PUPDR_PUPDR0_0 | GPIO_PUPDR_PUPDR1_0;
+    straps = I2C_BASE_ADDR + (GPIOF->IDR & 3);
+    addr = config_param(PARAM_I2C_ADDR);
+    if (!addr)
+        addr = straps + config_param(PARAM_ADDR_OFFSET);
+    if (!I2C_ADDR_VALID(addr))
+        addr = straps;
+    I2C1->OAR1 = I2C_OAR1_OA1EN | addr << 1;
+    I2C1->CR1 = I2C_CR1_PE;
+
+    SysTick->LOAD = 8000 - 1;
+    SysTick->VAL = 0;
+    SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk;
+
+    while (1)
+    {
+        if (I2C1->ISR & I2C_ISR_ADDR)
+            transfer();
+        if (I2C1->ISR & (I2C_ISR_BERR | I2C_ISR_ARLO | I2C_ISR_OVR))
+            I2C1->ICR = I2C_ICR_BERRCF | I2C_ICR_ARLOCF | I2C_ICR_OVRCF;
+    }
+
+    return 0;
+}
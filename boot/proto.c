@@ -0,0 +1,194 @@
+#include "boot.h"
+#include "proto.h"
+
+/*
+ * Bootloader commands, without hardware access so the uploader can run
+ * them against a simulated target.
+ *
+ * A page is sent as BOOT_BLOCKS blocks into a RAM buffer, each with the
+ * CRC of its data, and then written with the CRC of the whole page. The
+ * CRC is the STM32 CRC unit default: CRC-32 polynomial, initial value
+ * 0xffffffff, fed with little endian words, no reflection, no final xor.
+ * Pages whose flash CRC already matches can be skipped, which is how an
+ * interrupted transfer resumes.
+ *
+ * A page can also be sent compressed, as BOOT_BLOCK byte chunks of an LZSS
+ * stream (see boot.h) that are decoded into the page buffer as they come,
+ * the buffer is the window. The last chunk is padded, decoding stops at
+ * the end of the page. Chunks go in order, a repeated chunk is ignored.
+ */
+
+#define BLOCKS_ALL              ((1u << BOOT_BLOCKS) - 1)
+
+static uint32_t page_buf[FLASH_PAGE / 4];
+static uint16_t page_blocks;
+
+static uint16_t z_out;
+static uint8_t z_next;
+static uint8_t z_flags, z_bits;
+static uint8_t z_token, z_half;
+
+static uint32_t get32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint8_t load(const uint8_t *rx, uint16_t len)
+{
+    uint8_t block = rx[1];
+    uint8_t *dst = (uint8_t *)page_buf + block * BOOT_BLOCK;
+    uint8_t i;
+
+    if (len != BOOT_FRAME || block >= BOOT_BLOCKS)
+        return BOOT_ERR_ARG;
+
+    page_blocks &= ~(1u << block);
+    for (i = 0; i < BOOT_BLOCK; i++)
+        dst[i] = rx[2 + i];
+    if (boot_crc(page_buf + block * BOOT_BLOCK / 4, BOOT_BLOCK / 4) != get32(rx + 2 + BOOT_BLOCK))
+        return BOOT_ERR_CRC;
+
+    page_blocks |= 1u << block;
+    return BOOT_OK;
+}
+
+static uint8_t program(const uint8_t *rx, uint16_t len, uint32_t *value)
+{
+    uint8_t page = rx[1];
+    uint32_t crc = get32(rx + 2);
+
+    if (len != 6 || page >= APP_PAGES)
+        return BOOT_ERR_ARG;
+    if (page_blocks != BLOCKS_ALL)
+        return BOOT_ERR_SEQ;
+    if (boot_crc(page_buf, FLASH_PAGE / 4) != crc)
+        return BOOT_ERR_CRC;
+
+    page_blocks = 0;
+    if (boot_flash_page(page, page_buf))
+        return BOOT_ERR_FLASH;
+    *value = boot_crc(boot_app() + page * FLASH_PAGE / 4, FLASH_PAGE / 4);
+    return *value == crc ? BOOT_OK : BOOT_ERR_FLASH;
+}
+
+static uint8_t unpack(const uint8_t *in, uint8_t len)
+{
+    uint8_t *out = (uint8_t *)page_buf;
+    uint16_t token, dist, n;
+
+    for (; len && z_out < FLASH_PAGE; len--, in++)
+    {
+        if (z_bits == 0)
+        {
+            z_flags = *in;
+            z_bits = 8;
+            continue;
+        }
+        if (z_flags & 1)
+        {
+            out[z_out++] = *in;
+            z_flags >>= 1;
+            z_bits--;
+            continue;
+        }
+        if (!z_half)
+        {
+            z_token = *in;
+            z_half = 1;
+            continue;
+        }
+
+        z_half = 0;
+        z_flags >>= 1;
+        z_bits--;
+        token = z_token | (uint16_t)*in << 8;
+        dist = (token >> 6) + 1;
+        n = (token & 0x3f) + LZ_MIN;
+        if (dist > z_out || z_out + n > FLASH_PAGE)
+            return BOOT_ERR_ARG;
+        for (; n; n--, z_out++)
+            out[z_out] = out[z_out - dist];
+    }
+    return BOOT_OK;
+}
+
+static uint8_t zload(const uint8_t *rx, uint16_t len)
+{
+    uint32_t chunk[BOOT_BLOCK / 4];
+    uint8_t *dst = (uint8_t *)chunk;
+    uint8_t i, rc;
+
+    if (len != BOOT_FRAME)
+        return BOOT_ERR_ARG;
+    if (rx[1] == 0)
+    {
+        page_blocks = 0;
+        z_out = 0;
+        z_next = 0;
+        z_bits = 0;
+        z_half = 0;
+    }
+    else if (rx[1] + 1 == z_next)
+        return BOOT_OK;
+    if (rx[1] != z_next)
+        return BOOT_ERR_SEQ;
+
+    for (i = 0; i < BOOT_BLOCK; i++)
+        dst[i] = rx[2 + i];
+    if (boot_crc(chunk, BOOT_BLOCK / 4) != get32(rx + 2 + BOOT_BLOCK))
+        return BOOT_ERR_CRC;
+
+    rc = unpack(rx + 2, BOOT_BLOCK);
+    if (rc != BOOT_OK)
+    {
+        z_next = 0xff;
+        return rc;
+    }
+    z_next++;
+    if (z_out == FLASH_PAGE)
+        page_blocks = BLOCKS_ALL;
+    return BOOT_OK;
+}
+
+int Boot_Image_Valid(void)
+{
+    const uint32_t *app = boot_app();
+
+    return boot_crc(app, APP_SIZE / 4 - 1) == app[APP_SIZE / 4 - 1];
+}
+
+uint8_t Boot_Command(const uint8_t *rx, uint16_t len, uint32_t *value)
+{
+    *value = 0;
+    if (len == 0)
+        return BOOT_ERR_ARG;
+
+    switch (rx[0])
+    {
+        case BOOT_CMD_INFO:
+            *value = (uint32_t)BOOT_VERSION << 24 | (uint32_t)APP_PAGES << 16 | FLASH_PAGE;
+        return BOOT_OK;
+
+        case BOOT_CMD_LOAD:
+        return load(rx, len);
+
+        case BOOT_CMD_WRITE:
+        return program(rx, len, value);
+
+        case BOOT_CMD_CRC:
+            if (len != 2 || rx[1] >= APP_PAGES)
+                return BOOT_ERR_ARG;
+            *value = boot_crc(boot_app() + rx[1] * FLASH_PAGE / 4, FLASH_PAGE / 4);
+        return BOOT_OK;
+
+        case BOOT_CMD_ZLOAD:
+        return zload(rx, len);
+
+        case BOOT_CMD_RUN:
+            if (!Boot_Image_Valid())
+                return BOOT_ERR_IMAGE;
+            boot_run();
+        return BOOT_OK;
+    }
+    return BOOT_ERR_ARG;
+}
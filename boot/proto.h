@@ -0,0 +1,15 @@
+#ifndef __PROTO_H
+#define __PROTO_H
+
+#include <stdint.h>
+
+extern uint8_t Boot_Command(const uint8_t *rx, uint16_t len, uint32_t *value);
+extern int Boot_Image_Valid(void);
+
+/* provided by the target, or by the simulated target of the uploader */
+extern uint32_t boot_crc(const uint32_t *data, uint32_t words);
+extern int boot_flash_page(uint8_t page, const uint32_t *data);
+extern const uint32_t *boot_app(void);
+extern void boot_run(void);
+
+#endif
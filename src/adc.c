@@ -0,0 +1,368 @@
+#include "stm32f030x6.h"
+#include "adc.h"
+#include "spare.h"
+#include "tb6612.h"
+
+/*
+ * Conversions are triggered by TIM3 channel 4 (OC4REF as TRGO) in the
+ * middle of every PWM period, away from the switching edges. Each
+ * trigger scans the enabled channels in ascending order: PA5 (channel 5,
+ * only when it is the supply sense input), the temperature sensor
+ * (channel 16) and VREFINT (channel 17). DMA writes the results into a
+ * circular buffer; every half buffer of ADC_SCANS scans is averaged per
+ * channel in the DMA interrupt. Nothing runs per sample on the CPU. The
+ * block rate follows the PWM frequency, so the slower IIR averages are
+ * instead fed the latest block from Adc_Tick() every millisecond, and
+ * their time constants (in ms below) do not change with Set_Freq().
+ *
+ * Motor supply sense on PA5 through a divider, low pass filtered.
+ * vsense_scale is the supply voltage in mV that reads as ADC full scale.
+ * With a nominal voltage set the duty of both motors is scaled by
+ * nominal / measured so the average motor voltage stays constant as the
+ * battery discharges.
+ *
+ * The temperature sensor reading is turned into 0.1 C from the factory
+ * TS_CAL1 point (30 C at 3.3 V) and the typical 4.3 mV/C slope. Above
+ * temp_limit the maximum duty of both channels is reduced linearly,
+ * reaching zero at temp_limit + temp_span.
+ *
+ * VREFINT gives VDDA = 3.3 V * VREFINT_CAL / reading. Undervoltage is
+ * checked on every block (ADC_SCANS PWM periods): below uvlo_mv the
+ * bridges are put in standby and held there, and a fault is latched.
+ * Once the blocks have shown VDDA above uvlo_mv + uvlo_hyst for
+ * UVLO_RECOVER ms commands are accepted again. The thresholds are kept as
+ * raw readings so the check needs no division.
+ */
+
+#define ADC_SCANS               4
+#define ADC_CHANNELS            3
+#define ADC_HALF                (ADC_SCANS * ADC_CHANNELS)
+#define AVG_SHIFT               6       /* 64 ms */
+
+#define VSENSE_SHIFT            4       /* 16 ms */
+#define VCOMP_INTERVAL          128     /* ms */
+#define TEMP_SHIFT              4
+#define THERM_INTERVAL          512
+#define UVLO_RECOVER            256
+
+#define TS_CAL1                 (*(const uint16_t *)0x1ffff7b8)
+#define VREFINT_CAL             (*(const uint16_t *)0x1ffff7ba)
+
+static uint32_t vsense_filt;
+static uint16_t vsense_mv;
+static uint16_t vsense_scale = 3300;
+static uint16_t vcomp_nominal;
+static uint32_t temp_filt;
+static int16_t temp_dc;
+static int16_t temp_limit;
+static uint16_t temp_span = 200;
+static uint16_t therm_limit = SCALE_ONE;
+
+static uint16_t uvlo_mv = 2700;
+static uint16_t uvlo_hyst = 100;
+static uint16_t uvlo_trip;
+static uint16_t uvlo_clear;
+static uint16_t uvlo_count;
+static volatile uint8_t uvlo_seen;     /* blocks since the last tick: 1 clear, 2 not */
+static volatile uint8_t uvlo_state;
+
+static uint16_t adc_buf[2 * ADC_HALF];
+static uint8_t adc_vsense;
+static uint8_t adc_nch;
+static volatile uint16_t adc_block[ADC_CHANNELS];   /* indexed by ADC_AVG_* */
+static volatile uint8_t adc_seen;
+static uint32_t adc_avg[ADC_CHANNELS];  /* Q6 */
+
+static void uvlo_thresholds(void)
+{
+    uint32_t k = (uint32_t)VREFINT_CAL * 3300;
+
+    uvlo_trip = 0xffff;
+    uvlo_clear = 0xffff;
+    if (uvlo_mv)
+    {
+        uvlo_trip = k / uvlo_mv;
+        uvlo_clear = k / (uvlo_mv + uvlo_hyst);
+    }
+}
+
+static void adc_start(uint8_t vsense)
+{
+    if (ADC1->CR & ADC_CR_ADSTART)
+    {
+        ADC1->CR |= ADC_CR_ADSTP;
+        while (ADC1->CR & ADC_CR_ADSTP);
+    }
+    DMA1_Channel1->CCR = 0;
+
+    adc_vsense = vsense;
+    adc_seen = 0;
+    adc_nch = vsense ? 3 : 2;
+    ADC1->CHSELR = ADC_CHSELR_CHSEL16 | ADC_CHSELR_CHSEL17 |
+        (vsense ? ADC_CHSELR_CHSEL5 : 0);
+
+    DMA1->IFCR = DMA_IFCR_CGIF1;
+    DMA1_Channel1->CPAR = (uint32_t)&ADC1->DR;
+    DMA1_Channel1->CMAR = (uint32_t)adc_buf;
+    DMA1_Channel1->CNDTR = 2 * ADC_SCANS * adc_nch;
+    DMA1_Channel1->CCR = DMA_CCR_MINC | DMA_CCR_PSIZE_0 | DMA_CCR_MSIZE_0 |
+        DMA_CCR_CIRC | DMA_CCR_HTIE | DMA_CCR_TCIE | DMA_CCR_EN;
+
+    ADC1->CR |= ADC_CR_ADSTART;
+}
+
+void Adc_Init(void)
+{
+    RCC->APB2ENR |= RCC_APB2ENR_ADCEN;
+    RCC->AHBENR |= RCC_AHBENR_DMA1EN;
+
+    ADC1->CFGR2 = ADC_CFGR2_CKMODE_0;
+    ADC1->CR = ADC_CR_ADCAL;
+    while (ADC1->CR & ADC_CR_ADCAL);
+
+    ADC1->CR = ADC_CR_ADEN;
+    while ((ADC1->ISR & ADC_ISR_ADRDY) == 0);
+
+    /* 55.5 cycles, over the 4 us the internal channels need */
+    ADC1->SMPR = ADC_SMPR_SMP_2 | ADC_SMPR_SMP_0;
+    /* TRG3 = TIM3_TRGO on rising edge, circular DMA */
+    ADC1->CFGR1 = ADC_CFGR1_EXTEN_0 | ADC_CFGR1_EXTSEL_1 | ADC_CFGR1_EXTSEL_0 |
+        ADC_CFGR1_DMACFG | ADC_CFGR1_DMAEN;
+    ADC1_COMMON->CCR |= ADC_CCR_TSEN | ADC_CCR_VREFEN;
+
+    /* OC4REF rises at CCR4, kept at half the period by Set_Freq() */
+    TIM3->CCMR2 = TIM_CCMR2_OC4M_2 | TIM_CCMR2_OC4M_1 | TIM_CCMR2_OC4M_0;
+    TIM3->CCR4 = TIM3->ARR >> 1;
+    TIM3->CR2 = TIM_CR2_MMS_2 | TIM_CR2_MMS_1 | TIM_CR2_MMS_0;
+
+    uvlo_thresholds();
+    NVIC_EnableIRQ(DMA1_Channel1_IRQn);
+    adc_start(0);
+}
+
+static void vcomp_update(void)
+{
+    uint32_t f = SCALE_ONE;
+
+    if (vcomp_nominal && vsense_mv)
+    {
+        f = ((uint32_t)vcomp_nominal << 12) / vsense_mv;
+        if (f > SCALE_MAX)
+            f = SCALE_MAX;
+    }
+    Set_TB6612_Scale(MOTOR_AB, SCALE_VSUPPLY, f);
+}
+
+static void therm_update(void)
+{
+    int32_t over = temp_dc - temp_limit;
+    uint32_t f = SCALE_ONE;
+
+    if (temp_limit && over > 0)
+        f = over >= temp_span ? 0 : SCALE_ONE - ((uint32_t)over << 12) / temp_span;
+    therm_limit = f;
+    Set_TB6612_Limit(f);
+}
+
+static void vsense_sample(uint16_t raw)
+{
+    static uint8_t n;
+
+    if (vsense_filt == 0)
+        vsense_filt = (uint32_t)raw << VSENSE_SHIFT;
+    vsense_filt += raw - (vsense_filt >> VSENSE_SHIFT);
+    vsense_mv = (vsense_filt * vsense_scale) >> (12 + VSENSE_SHIFT);
+    if (++n >= VCOMP_INTERVAL)
+    {
+        n = 0;
+        vcomp_update();
+    }
+}
+
+static void temp_sample(uint16_t raw)
+{
+    static uint16_t n;
+
+    if (temp_filt == 0)
+        temp_filt = (uint32_t)raw << TEMP_SHIFT;
+    temp_filt += raw - (temp_filt >> TEMP_SHIFT);
+    /* 3300 / 4096 / 4.3 * 10 = 1.874 dC per count */
+    temp_dc = 300 + (((int32_t)TS_CAL1 - (int32_t)(temp_filt >> TEMP_SHIFT)) * 1919 >> 10);
+    if (++n >= THERM_INTERVAL)
+    {
+        n = 0;
+        therm_update();
+    }
+}
+
+static void uvlo_check(uint16_t vref)
+{
+    uvlo_seen |= vref < uvlo_clear ? 1 : 2;
+    if (vref > uvlo_trip && (uvlo_state & UVLO_ACTIVE) == 0)
+    {
+        uvlo_state = UVLO_ACTIVE | UVLO_LATCHED;
+        Set_TB6612_Inhibit(1);
+    }
+}
+
+/* from Adc_Tick(), counts from the first clear block, any other restarts it */
+static void uvlo_recover(void)
+{
+    __disable_irq();
+    if ((uvlo_state & UVLO_ACTIVE) == 0 || (uvlo_seen & 2))
+    {
+        uvlo_count = 0;
+        uvlo_seen = 0;
+    }
+    else if ((uvlo_seen & 1) && ++uvlo_count >= UVLO_RECOVER)
+    {
+        uvlo_state &= ~UVLO_ACTIVE;
+        Set_TB6612_Inhibit(0);
+    }
+    __enable_irq();
+}
+
+void DMA1_Channel1_IRQHandler(void)
+{
+    const uint16_t *p = adc_buf;
+    uint32_t sum[ADC_CHANNELS] = { 0 };
+    uint8_t i, c, first;
+
+    if (DMA1->ISR & DMA_ISR_TCIF1)
+        p += ADC_SCANS * adc_nch;
+    DMA1->IFCR = DMA_IFCR_CGIF1;
+
+    first = ADC_CHANNELS - adc_nch;
+    for (i = 0; i < ADC_SCANS; i++)
+        for (c = first; c < ADC_CHANNELS; c++)
+            sum[c] += *p++;
+
+    for (c = first; c < ADC_CHANNELS; c++)
+        adc_block[c] = sum[c] / ADC_SCANS;
+    adc_seen = 1;
+
+    uvlo_check(adc_block[ADC_AVG_VREF]);
+}
+
+void Adc_Tick(void)
+{
+    uint8_t vsense = Get_Spare_Func(SPARE_PA5) == FUNC_VSENSE;
+    uint16_t raw;
+    uint8_t c;
+
+    if (vsense != adc_vsense)
+    {
+        vsense_filt = 0;
+        adc_avg[ADC_AVG_VSENSE] = 0;
+        adc_start(vsense);
+    }
+    if (!adc_seen)
+        return;
+
+    for (c = ADC_CHANNELS - adc_nch; c < ADC_CHANNELS; c++)
+    {
+        raw = adc_block[c];
+        if (adc_avg[c] == 0)
+            adc_avg[c] = (uint32_t)raw << AVG_SHIFT;
+        adc_avg[c] += raw - (adc_avg[c] >> AVG_SHIFT);
+    }
+
+    uvlo_recover();
+    if (adc_vsense)
+        vsense_sample(adc_block[ADC_AVG_VSENSE]);
+    temp_sample(adc_block[ADC_AVG_TEMP]);
+}
+
+uint16_t Get_Adc_Avg(uint8_t ch)
+{
+    return ch < ADC_CHANNELS ? adc_avg[ch] >> AVG_SHIFT : 0;
+}
+
+uint16_t Get_Vsupply(void)
+{
+    return vsense_mv;
+}
+
+void Set_Vsense_Scale(uint16_t mv)
+{
+    vsense_scale = mv;
+}
+
+uint16_t Get_Vsense_Scale(void)
+{
+    return vsense_scale;
+}
+
+void Set_Vcomp_Nominal(uint16_t mv)
+{
+    vcomp_nominal = mv;
+    vcomp_update();
+}
+
+uint16_t Get_Vcomp_Nominal(void)
+{
+    return vcomp_nominal;
+}
+
+int16_t Get_Temp(void)
+{
+    return temp_dc;
+}
+
+uint16_t Get_Therm_Limit(void)
+{
+    return therm_limit;
+}
+
+void Set_Temp_Limit(int16_t limit, uint16_t span)
+{
+    temp_limit = limit;
+    temp_span = span ? span : 1;
+    therm_update();
+}
+
+int16_t Get_Temp_Limit(void)
+{
+    return temp_limit;
+}
+
+uint16_t Get_Temp_Span(void)
+{
+    return temp_span;
+}
+
+uint16_t Get_Vdda(void)
+{
+    uint16_t vref = Get_Adc_Avg(ADC_AVG_VREF);
+
+    return vref ? (uint32_t)VREFINT_CAL * 3300 / vref : 0;
+}
+
+void Set_Uvlo(uint16_t mv, uint16_t hyst)
+{
+    uvlo_mv = mv;
+    uvlo_hyst = hyst;
+    uvlo_thresholds();
+}
+
+uint16_t Get_Uvlo_Mv(void)
+{
+    return uvlo_mv;
+}
+
+uint16_t Get_Uvlo_Hyst(void)
+{
+    return uvlo_hyst;
+}
+
+uint8_t Get_Uvlo_State(void)
+{
+    return uvlo_state;
+}
+
+void Clear_Uvlo_Latch(void)
+{
+    __disable_irq();
+    uvlo_state &= ~UVLO_LATCHED;
+    __enable_irq();
+}
@@ -0,0 +1,33 @@
+#ifndef __ADC_H
+#define __ADC_H
+
+#include <stdint.h>
+
+#define ADC_AVG_VSENSE          0
+#define ADC_AVG_TEMP            1
+#define ADC_AVG_VREF            2
+
+#define UVLO_ACTIVE             0x01
+#define UVLO_LATCHED            0x02
+
+extern void Adc_Init(void);
+extern void Adc_Tick(void);
+extern uint16_t Get_Adc_Avg(uint8_t ch);
+extern uint16_t Get_Vsupply(void);
+extern void Set_Vsense_Scale(uint16_t mv);
+extern uint16_t Get_Vsense_Scale(void);
+extern void Set_Vcomp_Nominal(uint16_t mv);
+extern uint16_t Get_Vcomp_Nominal(void);
+extern int16_t Get_Temp(void);
+extern uint16_t Get_Therm_Limit(void);
+extern void Set_Temp_Limit(int16_t limit, uint16_t span);
+extern int16_t Get_Temp_Limit(void);
+extern uint16_t Get_Temp_Span(void);
+extern uint16_t Get_Vdda(void);
+extern void Set_Uvlo(uint16_t mv, uint16_t hyst);
+extern uint16_t Get_Uvlo_Mv(void);
+extern uint16_t Get_Uvlo_Hyst(void);
+extern uint8_t Get_Uvlo_State(void);
+extern void Clear_Uvlo_Latch(void);
+
+#endif
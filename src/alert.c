@@ -0,0 +1,67 @@
+#include "stm32f030x6.h"
+#include "alert.h"
+#include "spare.h"
+#include "tb6612.h"
+#include "adc.h"
+#include "failsafe.h"
+
+/*
+ * Host alert line, SMBus style. Alert_Tick() latches an event on the edge
+ * that starts it. While an event of alert_mask is pending every spare pin
+ * set to FUNC_ALERT is pulled low, open drain so several shields share one
+ * line with the pull-up on the host side. The host finds the source with
+ * the events param and clears the events it has seen.
+ */
+
+static uint8_t alert_mask;
+static volatile uint8_t alert_events;
+static uint8_t alert_state;
+
+static void line(uint8_t low)
+{
+    if (Get_Spare_Func(SPARE_PA5) == FUNC_ALERT)
+        GPIOA->BSRR = 1u << (PIN_SPARE1 + (low ? 16 : 0));
+    if (Get_Spare_Func(SPARE_PB1) == FUNC_ALERT)
+        GPIOB->BSRR = 1u << (PIN_SPARE2 + (low ? 16 : 0));
+}
+
+void Alert_Set_Mask(uint8_t mask)
+{
+    alert_mask = mask & (ALERT_FAULT | ALERT_FAILSAFE | ALERT_DERATE);
+}
+
+uint8_t Alert_Get_Mask(void)
+{
+    return alert_mask;
+}
+
+uint8_t Alert_Events(void)
+{
+    return alert_events;
+}
+
+uint8_t Alert_Pending(void)
+{
+    return alert_events & alert_mask;
+}
+
+void Alert_Clear(uint8_t events)
+{
+    alert_events &= ~events;
+}
+
+void Alert_Tick(void)
+{
+    uint8_t state = 0;
+
+    if (Get_Uvlo_State() & UVLO_LATCHED)
+        state |= ALERT_FAULT;
+    if (Failsafe_Active())
+        state |= ALERT_FAILSAFE;
+    if (Get_Therm_Limit() < SCALE_ONE)
+        state |= ALERT_DERATE;
+
+    alert_events |= state & ~alert_state;
+    alert_state = state;
+    line(Alert_Pending() != 0);
+}
@@ -0,0 +1,17 @@
+#ifndef __ALERT_H
+#define __ALERT_H
+
+#include <stdint.h>
+
+#define ALERT_FAULT             0x01    /* undervoltage fault latched */
+#define ALERT_FAILSAFE          0x02    /* failsafe tripped */
+#define ALERT_DERATE            0x08    /* thermal derating started */
+
+extern void Alert_Set_Mask(uint8_t mask);
+extern uint8_t Alert_Get_Mask(void);
+extern uint8_t Alert_Events(void);
+extern uint8_t Alert_Pending(void);
+extern void Alert_Clear(uint8_t events);
+extern void Alert_Tick(void);
+
+#endif
@@ -0,0 +1,27 @@
+#include "stm32f030x6.h"
+#include "boot.h"
+
+/*
+ * The application starts at APP_BASE behind the bootloader. The M0 has no
+ * VTOR, so the vector table is copied to the start of RAM, which the
+ * linker script keeps free, and RAM is mapped at address 0.
+ */
+void Boot_Remap(void)
+{
+    const uint32_t *src = (const uint32_t *)APP_BASE;
+    uint32_t *dst = (uint32_t *)SRAM_BASE;
+    uint8_t i;
+
+    for (i = 0; i < APP_VECTORS; i++)
+        dst[i] = src[i];
+
+    RCC->APB2ENR |= RCC_APB2ENR_SYSCFGEN;
+    SYSCFG->CFGR1 |= SYSCFG_CFGR1_MEM_MODE;
+}
+
+/* reset into the bootloader, it stays there until told to run */
+void Boot_Enter(void)
+{
+    *(volatile uint32_t *)BOOT_FLAG_ADDR = BOOT_MAGIC;
+    NVIC_SystemReset();
+}
@@ -0,0 +1,55 @@
+#ifndef __BOOT_H
+#define __BOOT_H
+
+#include <stdint.h>
+
+/*
+ * Flash and RAM layout shared by the application, the I2C bootloader in
+ * boot/ and the uploader in tools/. The last word of the application
+ * area is the CRC of the rest of it, the bootloader only starts an image
+ * that matches.
+ */
+
+#define BOOT_BASE               0x08000000
+#define APP_BASE                0x08000800
+#define APP_SIZE                0x3000
+#define CONFIG_BASE             0x08003800      /* see config.c */
+#define CONFIG_MAGIC            0xc0f6
+#define FLASH_PAGE              1024
+#define APP_PAGES               (APP_SIZE / FLASH_PAGE)
+#define APP_VECTORS             48              /* copied to the start of RAM */
+
+#define BOOT_FLAG_ADDR          0x20000ffc
+#define BOOT_MAGIC              0xb0075e1f
+#define BOOT_VERSION            2
+
+/* I2C protocol, one write per command, a read returns status and a value */
+#define BOOT_BLOCK              64
+#define BOOT_BLOCKS             (FLASH_PAGE / BOOT_BLOCK)
+#define BOOT_FRAME              (2 + BOOT_BLOCK + 4)
+
+#define BOOT_CMD_INFO           0x00    /* value: version, pages, page size */
+#define BOOT_CMD_LOAD           0x01    /* block, data, CRC of data */
+#define BOOT_CMD_WRITE          0x02    /* page, CRC of page */
+#define BOOT_CMD_CRC            0x03    /* page, value: CRC of flash page */
+#define BOOT_CMD_RUN            0x04
+#define BOOT_CMD_ZLOAD          0x05    /* chunk, LZSS page stream, CRC of chunk */
+
+/* LZSS, a flag byte (bit set = literal, LSB first) before each 8 items, a
+ * match is a little endian 16 bit (distance - 1) << 6 | (length - 3) */
+#define LZ_MIN                  3
+#define LZ_MAX                  (LZ_MIN + 63)
+#define LZ_WINDOW               1024
+
+#define BOOT_OK                 0
+#define BOOT_ERR_ARG            1
+#define BOOT_ERR_CRC            2
+#define BOOT_ERR_SEQ            3
+#define BOOT_ERR_FLASH          4
+#define BOOT_ERR_IMAGE          5
+
+/* application side */
+extern void Boot_Remap(void);
+extern void Boot_Enter(void);
+
+#endif
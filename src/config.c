@@ -0,0 +1,335 @@
+#include "stm32f030x6.h"
+#include "config.h"
+#include "param.h"
+#include "tb6612.h"
+#include "watchdog.h"
+#include "boot.h"
+
+/*
+ * Persistent configuration in the last two flash pages.
+ *
+ * A page starts with a sequence number and CFG_MAGIC, followed by 4 byte
+ * records of a key ((motor << 8) | param id) and a value. Records are
+ * only appended, the value is programmed before the key so a torn record
+ * reads as unused. Saving appends the params that differ from the stored
+ * value; when the page is full the current values are written to the
+ * other page, whose magic is programmed last. At boot all records of the
+ * valid page with the higher sequence number are replayed in order.
+ * Config_Save_Param() stores a single param the same way; when it has to
+ * move to the other page it carries over the stored values, not the
+ * current ones.
+ *
+ * Erasing a page stalls the CPU, interrupts included, for up to 40 ms.
+ */
+
+#define CFG_PAGE_SIZE           FLASH_PAGE
+#define CFG_PAGE0               CONFIG_BASE
+#define CFG_PAGE1               (CFG_PAGE0 + CFG_PAGE_SIZE)
+#define CFG_MAGIC               CONFIG_MAGIC
+#define CFG_EMPTY               0xffff
+
+#define CFG_FREQ_LO             0xf0    /* keys outside the param ids */
+#define CFG_FREQ_HI             0xf1
+
+#define flash16(addr)           (*(volatile uint16_t *)(addr))
+
+static const uint8_t cfg_board[] = {
+    PARAM_PA5_FUNC, PARAM_PB1_FUNC, PARAM_ADDR_OFFSET, PARAM_I2C_ADDR,
+    PARAM_GEAR_RATIO, PARAM_GEAR_KP,
+    PARAM_DRIVE_TRACK, PARAM_DRIVE_SCALE, PARAM_DRIVE_INVERT,
+    PARAM_VSENSE_SCALE, PARAM_VCOMP_NOMINAL,
+    PARAM_TEMP_LIMIT, PARAM_TEMP_SPAN, PARAM_UVLO_MV, PARAM_UVLO_HYST,
+    PARAM_FS_TIMEOUT, PARAM_FS_ACTION, PARAM_FS_RAMP,
+    PARAM_ALERT_MASK,
+};
+
+static const uint8_t cfg_motor[] = {
+    PARAM_LUT_ENABLE, PARAM_KICK_PULSE, PARAM_KICK_PERIODS,
+    PARAM_HOLD_DELAY, PARAM_HOLD_SCALE,
+    PARAM_REV_PERIODS, PARAM_REV_RAMP, PARAM_REV_BRAKE,
+};
+
+static uint8_t addr_offset;
+static uint8_t i2c_addr;
+
+static uint32_t page_valid(uint32_t page)
+{
+    return flash16(page + 2) == CFG_MAGIC;
+}
+
+static uint32_t active_page(void)
+{
+    uint8_t v0 = page_valid(CFG_PAGE0), v1 = page_valid(CFG_PAGE1);
+
+    if (v0 && v1)
+        return (int16_t)(flash16(CFG_PAGE1) - flash16(CFG_PAGE0)) > 0 ? CFG_PAGE1 : CFG_PAGE0;
+    if (v0)
+        return CFG_PAGE0;
+    if (v1)
+        return CFG_PAGE1;
+    return 0;
+}
+
+static int flash_wait(void)
+{
+    uint32_t sr;
+
+    while (FLASH->SR & FLASH_SR_BSY);
+    sr = FLASH->SR;
+    FLASH->SR = FLASH_SR_EOP | FLASH_SR_PGERR | FLASH_SR_WRPRTERR;
+    return (sr & (FLASH_SR_PGERR | FLASH_SR_WRPRTERR)) ? -1 : 0;
+}
+
+static int flash_write(uint32_t addr, uint16_t value)
+{
+    int rc;
+
+    FLASH->CR |= FLASH_CR_PG;
+    flash16(addr) = value;
+    rc = flash_wait();
+    FLASH->CR &= ~FLASH_CR_PG;
+    return rc;
+}
+
+static int flash_erase(uint32_t page)
+{
+    int rc;
+
+    FLASH->CR |= FLASH_CR_PER;
+    FLASH->AR = page;
+    FLASH->CR |= FLASH_CR_STRT;
+    rc = flash_wait();
+    FLASH->CR &= ~FLASH_CR_PER;
+    return rc;
+}
+
+static void flash_unlock(void)
+{
+    Watchdog_Stretch(1);
+    if (FLASH->CR & FLASH_CR_LOCK)
+    {
+        FLASH->KEYR = FLASH_KEY1;
+        FLASH->KEYR = FLASH_KEY2;
+    }
+}
+
+static void flash_lock(void)
+{
+    FLASH->CR |= FLASH_CR_LOCK;
+    Watchdog_Stretch(0);
+}
+
+/* first slot with key and value unprogrammed, 0 if the page is full */
+static uint32_t free_slot(uint32_t page)
+{
+    uint32_t addr;
+
+    for (addr = page + 4; addr < page + CFG_PAGE_SIZE; addr += 4)
+        if (flash16(addr) == CFG_EMPTY && flash16(addr + 2) == CFG_EMPTY)
+            return addr;
+    return 0;
+}
+
+static int stored(uint32_t page, uint16_t key, uint16_t *value)
+{
+    uint32_t addr;
+    int found = 0;
+
+    for (addr = page + 4; addr < page + CFG_PAGE_SIZE; addr += 4)
+    {
+        if (flash16(addr) == key)
+        {
+            *value = flash16(addr + 2);
+            found = 1;
+        }
+    }
+    return found;
+}
+
+/* number of keys, and key/value n of the current configuration */
+#define CFG_KEYS                (sizeof(cfg_board) + 2 * (sizeof(cfg_motor) + LUT_POINTS) + 2)
+
+static uint16_t current(uint8_t n, uint16_t *value)
+{
+    uint8_t motor, id;
+
+    if (n < sizeof(cfg_board))
+    {
+        *value = Get_Param(MOTOR_A, cfg_board[n]);
+        return cfg_board[n];
+    }
+    n -= sizeof(cfg_board);
+    if (n < 2 * (sizeof(cfg_motor) + LUT_POINTS))
+    {
+        motor = n & 1;
+        n >>= 1;
+        id = n < sizeof(cfg_motor) ? cfg_motor[n] : PARAM_LUT_0 + n - sizeof(cfg_motor);
+        *value = Get_Param(motor, id);
+        return (uint16_t)motor << 8 | id;
+    }
+    n -= 2 * (sizeof(cfg_motor) + LUT_POINTS);
+    *value = n ? Get_Freq() >> 16 : Get_Freq();
+    return n ? CFG_FREQ_HI : CFG_FREQ_LO;
+}
+
+static int append(uint32_t addr, uint16_t key, uint16_t value)
+{
+    if (flash_write(addr + 2, value))
+        return -1;
+    return flash_write(addr, key);
+}
+
+static int save_changed(uint32_t page)
+{
+    uint32_t addr;
+    uint16_t key, value, old;
+    uint8_t n;
+
+    for (n = 0; n < CFG_KEYS; n++)
+    {
+        key = current(n, &value);
+        if (stored(page, key, &old) && old == value)
+            continue;
+        addr = free_slot(page);
+        if (!addr || append(addr, key, value))
+            return -1;
+    }
+    return 0;
+}
+
+static int save_all(uint32_t page, uint16_t seq)
+{
+    uint32_t addr = page + 4;
+    uint16_t key, value;
+    uint8_t n;
+
+    if (flash_erase(page))
+        return -1;
+    for (n = 0; n < CFG_KEYS; n++, addr += 4)
+    {
+        key = current(n, &value);
+        if (append(addr, key, value))
+            return -1;
+    }
+    if (flash_write(page, seq))
+        return -1;
+    return flash_write(page + 2, CFG_MAGIC);
+}
+
+/* the last stored value of each key on page, with key set to value */
+static int move_page(uint32_t page, uint16_t seq, uint16_t key, uint16_t value)
+{
+    uint32_t to = page == CFG_PAGE0 ? CFG_PAGE1 : CFG_PAGE0;
+    uint32_t addr, dst = to + 4;
+    uint16_t k, v;
+
+    if (flash_erase(to))
+        return -1;
+    for (addr = page + 4; page && addr < page + CFG_PAGE_SIZE; addr += 4)
+    {
+        k = flash16(addr);
+        if (k == CFG_EMPTY || k == key || stored(to, k, &v))
+            continue;
+        stored(page, k, &v);
+        if (append(dst, k, v))
+            return -1;
+        dst += 4;
+    }
+    if (append(dst, key, value) || flash_write(to, seq))
+        return -1;
+    return flash_write(to + 2, CFG_MAGIC);
+}
+
+void Config_Load(void)
+{
+    uint32_t page = active_page();
+    uint32_t addr, freq = 0;
+    uint16_t key, value;
+
+    if (!page)
+        return;
+
+    for (addr = page + 4; addr < page + CFG_PAGE_SIZE; addr += 4)
+    {
+        key = flash16(addr);
+        value = flash16(addr + 2);
+        if (key == CFG_EMPTY)
+            continue;
+        if ((key & 0xff) == CFG_FREQ_LO)
+            freq = (freq & 0xffff0000) | value;
+        else if ((key & 0xff) == CFG_FREQ_HI)
+            freq = (freq & 0xffff) | (uint32_t)value << 16;
+        else
+            Set_Param(key >> 8, key & 0xff, value);
+    }
+    if (freq)
+        Set_Freq(freq);
+}
+
+int Config_Save(void)
+{
+    uint32_t page = active_page();
+    int rc;
+
+    flash_unlock();
+    if (page && save_changed(page) == 0)
+        rc = 0;
+    else
+        rc = save_all(page == CFG_PAGE0 ? CFG_PAGE1 : CFG_PAGE0,
+            page ? flash16(page) + 1 : 0);
+    flash_lock();
+    return rc;
+}
+
+/* store one param and leave the other runtime values as they were saved */
+int Config_Save_Param(uint8_t motor, uint8_t id)
+{
+    uint32_t page = active_page(), addr;
+    uint16_t key = (uint16_t)motor << 8 | id;
+    uint16_t value = Get_Param(motor, id), old;
+    int rc;
+
+    if (page && stored(page, key, &old) && old == value)
+        return 0;
+
+    flash_unlock();
+    addr = page ? free_slot(page) : 0;
+    if (addr)
+        rc = append(addr, key, value);
+    else
+        rc = move_page(page, page ? flash16(page) + 1 : 0, key, value);
+    flash_lock();
+    return rc;
+}
+
+/* back to the built-in defaults at the next reset */
+int Config_Erase(void)
+{
+    int rc;
+
+    flash_unlock();
+    rc = flash_erase(CFG_PAGE0) | flash_erase(CFG_PAGE1);
+    flash_lock();
+    return rc;
+}
+
+void Set_Addr_Offset(uint8_t offset)
+{
+    addr_offset = offset & 0x7f;
+}
+
+uint8_t Get_Addr_Offset(void)
+{
+    return addr_offset;
+}
+
+/* an address assigned by the host, reserved ones and 0 leave it to the straps */
+void Set_I2c_Addr(uint8_t addr)
+{
+    i2c_addr = I2C_ADDR_VALID(addr) ? addr : 0;
+}
+
+uint8_t Get_I2c_Addr(void)
+{
+    return i2c_addr;
+}
@@ -0,0 +1,22 @@
+#ifndef __CONFIG_H
+#define __CONFIG_H
+
+#include <stdint.h>
+
+/*
+ * The F030 I2C has no SMBus mode, so address resolution answers on OAR2
+ * at 0x0d instead of 0x61. It cannot be a shield address.
+ */
+#define I2C_ARP_ADDR            0x0d    /* address resolution */
+#define I2C_ADDR_VALID(a)       ((a) >= 0x08 && (a) <= 0x77 && (a) != I2C_ARP_ADDR)
+
+extern void Config_Load(void);
+extern int Config_Save(void);
+extern int Config_Save_Param(uint8_t motor, uint8_t id);
+extern int Config_Erase(void);
+extern void Set_Addr_Offset(uint8_t offset);
+extern uint8_t Get_Addr_Offset(void);
+extern void Set_I2c_Addr(uint8_t addr);
+extern uint8_t Get_I2c_Addr(void);
+
+#endif
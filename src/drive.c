@@ -0,0 +1,102 @@
+#include "stm32f030x6.h"
+#include "drive.h"
+#include "tb6612.h"
+#include "gear.h"
+
+/*
+ * Differential drive, motor A is the left wheel and motor B the right.
+ *
+ * v and w are signed fractions of DRIVE_FULL_SCALE. The wheel speeds are
+ * v -/+ w * track (Q8.8); if either exceeds full scale both are reduced
+ * by the same factor so the curvature is kept. Full scale maps to
+ * scale (Q8, 0x100 = 100%) of the PWM period.
+ */
+
+static uint16_t drive_track = 0x0100;
+static uint16_t drive_scale = 0x0100;
+static uint8_t drive_invert;
+
+static int32_t iabs(int32_t x)
+{
+    return x < 0 ? -x : x;
+}
+
+/* largest Q15 factor q with m * q <= DRIVE_FULL_SCALE << 15, no division */
+static int32_t fit_scale(int32_t m)
+{
+    int32_t q = 0;
+    int32_t bit;
+
+    for (bit = 1 << 14; bit; bit >>= 1)
+        if (m * (q | bit) <= (int32_t)DRIVE_FULL_SCALE << 15)
+            q |= bit;
+    return q;
+}
+
+/* pulse for a wheel speed, rounded, full scale gives full; the sign goes into dir */
+static uint16_t drive_wheel(uint8_t motor, int32_t speed, uint32_t full, uint8_t *dir)
+{
+    *dir = DIR_CW;
+    if (drive_invert & (1 << motor))
+        speed = -speed;
+    if (speed < 0)
+    {
+        *dir = DIR_CCW;
+        speed = -speed;
+    }
+    return (speed * full + DRIVE_FULL_SCALE / 2) / DRIVE_FULL_SCALE;
+}
+
+void Drive_Set_Velocity(int16_t v, int16_t w)
+{
+    int32_t dw = ((int32_t)w * drive_track) >> 8;
+    int32_t left = v - dw;
+    int32_t right = v + dw;
+    int32_t m = iabs(left) > iabs(right) ? iabs(left) : iabs(right);
+    uint32_t full = ((TIM3->ARR + 1) * drive_scale) >> 8;
+    uint16_t pulse_a, pulse_b;
+    uint8_t dir_a, dir_b;
+
+    if (m > DRIVE_FULL_SCALE)
+    {
+        int32_t q = fit_scale(m);
+
+        left = (left * q) >> 15;
+        right = (right * q) >> 15;
+    }
+
+    /* one commit, both wheels change in the same PWM period */
+    pulse_a = drive_wheel(MOTOR_A, left, full, &dir_a);
+    pulse_b = drive_wheel(MOTOR_B, right, full, &dir_b);
+    Set_TB6612_Drive(dir_a, pulse_a, Gear_Enabled() ? DIR_KEEP : dir_b, pulse_b);
+}
+
+void Drive_Set_Track(uint16_t track)
+{
+    drive_track = track > 0x1000 ? 0x1000 : track;
+}
+
+void Drive_Set_Scale(uint16_t scale)
+{
+    drive_scale = scale > 0x0100 ? 0x0100 : scale;
+}
+
+void Drive_Set_Invert(uint8_t mask)
+{
+    drive_invert = mask & 3;
+}
+
+uint16_t Drive_Get_Track(void)
+{
+    return drive_track;
+}
+
+uint16_t Drive_Get_Scale(void)
+{
+    return drive_scale;
+}
+
+uint8_t Drive_Get_Invert(void)
+{
+    return drive_invert;
+}
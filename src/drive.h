@@ -0,0 +1,16 @@
+#ifndef __DRIVE_H
+#define __DRIVE_H
+
+#include <stdint.h>
+
+#define DRIVE_FULL_SCALE        2047
+
+extern void Drive_Set_Velocity(int16_t v, int16_t w);
+extern void Drive_Set_Track(uint16_t track);
+extern void Drive_Set_Scale(uint16_t scale);
+extern void Drive_Set_Invert(uint8_t mask);
+extern uint16_t Drive_Get_Track(void);
+extern uint16_t Drive_Get_Scale(void);
+extern uint8_t Drive_Get_Invert(void);
+
+#endif
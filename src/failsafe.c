@@ -0,0 +1,115 @@
+#include "stm32f030x6.h"
+#include "failsafe.h"
+#include "tb6612.h"
+#include "gear.h"
+
+/*
+ * Command silence failsafe.
+ *
+ * Runs from the 1 ms tick task. Every accepted command feeds it, after
+ * fs_timeout ms without one both channels coast, brake, go to standby or
+ * are scaled down to zero over fs_ramp ms and then coast. Gearing is left
+ * first. The next command clears the failsafe, the
+ * motors stay stopped until they are commanded again, also when that
+ * command comes during the ramp.
+ */
+
+#define FS_LEVEL_ONE            (1ul << 24)
+
+static uint16_t fs_timeout;
+static uint8_t fs_action;
+static uint16_t fs_ramp;
+static uint32_t fs_step = FS_LEVEL_ONE;
+static volatile uint16_t fs_silence;
+static volatile uint8_t fs_active;
+static uint32_t fs_level;
+
+static void coast(void)
+{
+    Set_TB6612_Dir(MOTOR_AB, DIR_STOP, 0);
+}
+
+static void trip(void)
+{
+    fs_active = 1;
+    if (Gear_Enabled())
+        Gear_Enable(0);
+
+    switch (fs_action)
+    {
+        case FAILSAFE_BRAKE:
+            Set_TB6612_Dir(MOTOR_AB, DIR_BRAKE, 0);
+        break;
+
+        case FAILSAFE_RAMP:
+            fs_level = FS_LEVEL_ONE;
+        break;
+
+        case FAILSAFE_STANDBY:
+            Set_TB6612_Dir(MOTOR_AB, DIR_STANDBY, 0);
+        break;
+
+        default:
+            coast();
+        break;
+    }
+}
+
+void Failsafe_Set(uint16_t timeout, uint8_t action, uint16_t ramp)
+{
+    fs_timeout = timeout;
+    fs_action = action > FAILSAFE_STANDBY ? FAILSAFE_COAST : action;
+    fs_ramp = ramp;
+    fs_step = ramp ? FS_LEVEL_ONE / ramp : FS_LEVEL_ONE;
+    fs_silence = 0;
+}
+
+uint16_t Failsafe_Get_Timeout(void)
+{
+    return fs_timeout;
+}
+
+uint8_t Failsafe_Get_Action(void)
+{
+    return fs_action;
+}
+
+uint16_t Failsafe_Get_Ramp(void)
+{
+    return fs_ramp;
+}
+
+uint8_t Failsafe_Active(void)
+{
+    return fs_active;
+}
+
+void Failsafe_Feed(void)
+{
+    fs_silence = 0;
+    if (!fs_active)
+        return;
+
+    coast();
+    fs_active = 0;
+    fs_level = 0;
+    Set_TB6612_Scale(MOTOR_AB, SCALE_FAILSAFE, SCALE_ONE);
+}
+
+void Failsafe_Tick(void)
+{
+    if (fs_active)
+    {
+        if (fs_level == 0)
+            return;
+        fs_level = fs_level > fs_step ? fs_level - fs_step : 0;
+        Set_TB6612_Scale(MOTOR_AB, SCALE_FAILSAFE, fs_level >> 12);
+        if (fs_level == 0)
+            coast();
+        return;
+    }
+
+    if (fs_timeout == 0 || ++fs_silence < fs_timeout)
+        return;
+    trip();
+}
@@ -0,0 +1,19 @@
+#ifndef __FAILSAFE_H
+#define __FAILSAFE_H
+
+#include <stdint.h>
+
+#define FAILSAFE_COAST          0
+#define FAILSAFE_BRAKE          1
+#define FAILSAFE_RAMP           2
+#define FAILSAFE_STANDBY        3
+
+extern void Failsafe_Set(uint16_t timeout, uint8_t action, uint16_t ramp);
+extern uint16_t Failsafe_Get_Timeout(void);
+extern uint8_t Failsafe_Get_Action(void);
+extern uint16_t Failsafe_Get_Ramp(void);
+extern uint8_t Failsafe_Active(void);
+extern void Failsafe_Feed(void);
+extern void Failsafe_Tick(void);
+
+#endif
@@ -0,0 +1,90 @@
+#include "frame.h"
+
+/*
+ * Packet framing for byte stream transports.
+ *
+ *   FRAME_SOF | len | len payload bytes | CRC-8
+ *
+ * The CRC (polynomial 0x07, initial 0) covers len and the payload. The
+ * receiver hunts for FRAME_SOF, a bad length or CRC drops the packet and
+ * the hunt starts over, so it resynchronises on the next packet. Nothing
+ * here touches hardware, the host tools use it as well.
+ */
+
+#define RX_SYNC                 0
+#define RX_LEN                  1
+#define RX_DATA                 2
+#define RX_CRC                  3
+
+static uint8_t rx_buf[FRAME_MAX];
+static uint8_t rx_state, rx_len, rx_pos, rx_crc;
+
+uint8_t Frame_Crc(uint8_t crc, uint8_t b)
+{
+    uint8_t i;
+
+    crc ^= b;
+    for (i = 0; i < 8; i++)
+        crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+    return crc;
+}
+
+/* returns the packet size, out holds FRAME_SIZE(len) bytes */
+uint8_t Frame_Pack(uint8_t *out, const uint8_t *payload, uint8_t len)
+{
+    uint8_t i, crc;
+
+    out[0] = FRAME_SOF;
+    out[1] = len;
+    crc = Frame_Crc(0, len);
+    for (i = 0; i < len; i++)
+    {
+        out[2 + i] = payload[i];
+        crc = Frame_Crc(crc, payload[i]);
+    }
+    out[2 + len] = crc;
+    return FRAME_SIZE(len);
+}
+
+/* feeds one received byte, returns the payload length once a packet is complete */
+uint8_t Frame_Rx(uint8_t b)
+{
+    switch (rx_state)
+    {
+        case RX_SYNC:
+            if (b == FRAME_SOF)
+                rx_state = RX_LEN;
+        break;
+
+        case RX_LEN:
+            if (b == 0 || b > FRAME_MAX)
+            {
+                rx_state = b == FRAME_SOF ? RX_LEN : RX_SYNC;
+                break;
+            }
+            rx_len = b;
+            rx_pos = 0;
+            rx_crc = Frame_Crc(0, b);
+            rx_state = RX_DATA;
+        break;
+
+        case RX_DATA:
+            rx_buf[rx_pos++] = b;
+            rx_crc = Frame_Crc(rx_crc, b);
+            if (rx_pos == rx_len)
+                rx_state = RX_CRC;
+        break;
+
+        case RX_CRC:
+            rx_state = RX_SYNC;
+            if (b == rx_crc)
+                return rx_len;
+        break;
+    }
+    return 0;
+}
+
+uint8_t *Frame_Payload(void)
+{
+    return rx_buf;
+}
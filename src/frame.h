@@ -0,0 +1,15 @@
+#ifndef __FRAME_H
+#define __FRAME_H
+
+#include <stdint.h>
+
+#define FRAME_SOF               0xa5
+#define FRAME_MAX               16      /* payload bytes, four commands */
+#define FRAME_SIZE(len)         ((len) + 3)
+
+extern uint8_t Frame_Crc(uint8_t crc, uint8_t b);
+extern uint8_t Frame_Pack(uint8_t *out, const uint8_t *payload, uint8_t len);
+extern uint8_t Frame_Rx(uint8_t b);
+extern uint8_t *Frame_Payload(void);
+
+#endif
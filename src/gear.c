@@ -0,0 +1,99 @@
+#include "stm32f030x6.h"
+#include "gear.h"
+#include "spare.h"
+#include "tb6612.h"
+
+/*
+ * Electronic gearing, motor B follows motor A.
+ *
+ * Runs from the SysTick interrupt every 1 ms, so its period does not
+ * depend on the tasks of the main loop; it is late by at most the longest
+ * other handler or interrupts off section. A flash erase still stalls it
+ * with the whole CPU, the code runs from flash. The position error
+ * between A's tach count scaled by the ratio (signed Q8.8, 0x0100 = 1:1)
+ * and B's tach count is accumulated in Q8 counts. B's duty is A's duty
+ * scaled by the ratio (feed-forward) plus the error times the gain in
+ * duty ticks per count.
+ */
+
+#define GEAR_ERR_MAX            (1L << 23)
+
+static volatile uint8_t gear_on;
+static int16_t gear_ratio = 0x0100;
+static uint16_t gear_kp = 16;
+static int32_t gear_err;
+static int32_t last_a, last_b;
+
+void Gear_Enable(uint8_t on)
+{
+    __disable_irq();
+    gear_on = 0;
+    if (on)
+    {
+        gear_err = 0;
+        last_a = Get_Tach_Count(MOTOR_A);
+        last_b = Get_Tach_Count(MOTOR_B);
+        gear_on = 1;
+    }
+    __enable_irq();
+}
+
+uint8_t Gear_Enabled(void)
+{
+    return gear_on;
+}
+
+void Gear_Set_Ratio(int16_t ratio)
+{
+    gear_ratio = ratio;
+}
+
+void Gear_Set_Gain(uint16_t kp)
+{
+    gear_kp = kp > 255 ? 255 : kp;
+}
+
+int16_t Gear_Get_Ratio(void)
+{
+    return gear_ratio;
+}
+
+uint16_t Gear_Get_Gain(void)
+{
+    return gear_kp;
+}
+
+void Gear_Tick(void)
+{
+    int32_t a, b, u, max;
+    uint8_t dir;
+
+    if (!gear_on)
+        return;
+
+    a = Get_Tach_Count(MOTOR_A);
+    b = Get_Tach_Count(MOTOR_B);
+    gear_err += (a - last_a) * gear_ratio - ((b - last_b) << 8);
+    last_a = a;
+    last_b = b;
+
+    if (gear_err > GEAR_ERR_MAX)
+        gear_err = GEAR_ERR_MAX;
+    else if (gear_err < -GEAR_ERR_MAX)
+        gear_err = -GEAR_ERR_MAX;
+
+    dir = Get_TB6612_Dir(MOTOR_A);
+    if (dir == DIR_STANDBY)
+        return;
+
+    u = Get_TB6612_Pulse(MOTOR_A);
+    if (dir == DIR_CCW)
+        u = -u;
+    u = ((u * gear_ratio) >> 8) + ((gear_err * gear_kp) >> 8);
+
+    max = TIM3->ARR + 1;
+    if (u >= 0)
+        Set_TB6612_Dir(MOTOR_B, DIR_CW, u > max ? max : u);
+    else
+        Set_TB6612_Dir(MOTOR_B, DIR_CCW, -u > max ? max : -u);
+}
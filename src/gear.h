@@ -0,0 +1,14 @@
+#ifndef __GEAR_H
+#define __GEAR_H
+
+#include <stdint.h>
+
+extern void Gear_Enable(uint8_t on);
+extern uint8_t Gear_Enabled(void);
+extern void Gear_Set_Ratio(int16_t ratio);
+extern void Gear_Set_Gain(uint16_t kp);
+extern int16_t Gear_Get_Ratio(void);
+extern uint16_t Gear_Get_Gain(void);
+extern void Gear_Tick(void);
+
+#endif
@@ -1,82 +1,276 @@
 #include "stm32f030x6.h"
 #include "user_i2c.h"
 #include "tb6612.h"
+#include "gear.h"
+#include "adc.h"
+#include "failsafe.h"
+#include "watchdog.h"
+#include "sched.h"
+#include "config.h"
+#include "param.h"
+#include "boot.h"
+#include "frame.h"
+#include "uart.h"
+#include "alert.h"
 
 #define I2C_BASE_ADDR           0x2d
 
-#define MODE_IN                 0x00
-#define MODE_OUT                0x01
-#define MODE_AF                 0x02
-#define MODE_AN                 0x03
-#define MODER(mode, pin)        ((mode) << (2 * (pin)))
+#define EV_I2C                  0
+#define EV_TICK                 1
+#define EV_UART                 2
+#define EV_ARP                  3
 
-volatile uint32_t timeout = 0;
+#ifdef TRANSPORT_UART
+/*
+ * With TRANSPORT_UART the same commands come over USART1 on the I2C pins,
+ * up to four per packet (see frame.c). Every packet is answered with one
+ * of the same length holding the reply after each of its commands.
+ */
+static void uart_task(void)
+{
+    uint8_t reply[FRAME_MAX], pkt[FRAME_SIZE(FRAME_MAX)];
+    uint8_t *cmd, b, len, i, j;
 
-void SysTick_Handler(void)
+    while (Uart_Read(&b)) {
+        len = Frame_Rx(b);
+        if (len == 0 || (len & 3))
+            continue;
+        cmd = Frame_Payload();
+        for (i = 0; i < len; i += 4) {
+            user_i2c_proc(cmd + i);
+            for (j = 0; j < 4; j++)
+                reply[i + j] = i2c_reply[j];
+        }
+        Uart_Write(pkt, Frame_Pack(pkt, reply, len));
+    }
+}
+#else
+/*
+ * I2C1 slave, interrupt driven. Written frames are queued for the main
+ * loop, a read sends the reply to the last get param. A read that comes
+ * while frames are still queued is held with SCL stretched (ADDR left
+ * set) until i2c_task has run them, so it always gets the reply to the
+ * write before it, even behind a flash erase. A repeated start ends the
+ * write the same as a stop.
+ *
+ * The address is the one assigned by the host, or else 0x2d plus the
+ * PF0/PF1 straps plus the address offset param. Assignment runs on
+ * I2C_ARP_ADDR (OAR2, see config.h), which every shield answers:
+ *
+ *   read 13 bytes          the 96 bit unique ID and its CRC-8 (frame.c)
+ *   write 0x01 uid addr    the shield with that ID takes addr and saves it
+ *   write 0x02             all shields drop their assigned address
+ *
+ * All shields without an address send their ID at once. The bus is a
+ * wired AND, a shield sending a 1 that reads back a 0 loses arbitration
+ * (ARLO) and sends only 0xff for the rest of the read, so the host gets
+ * the lowest ID intact. Shields with an address send 0xff throughout; a
+ * read of all 0xff means every shield has one.
+ */
+#define I2C_FRAMES              4
+
+#define ARP_ASSIGN              0x01
+#define ARP_RESET               0x02
+#define ARP_UID                 12
+#define ARP_FRAME               (1 + ARP_UID + 1)
+
+#define UID                     ((const uint8_t *)UID_BASE)
+
+static uint8_t i2c_frame[I2C_FRAMES][4];
+static volatile uint8_t i2c_head, i2c_tail;
+static uint8_t i2c_count;
+
+static uint8_t arp_frame[ARP_FRAME];
+static volatile uint8_t arp_len;
+static uint8_t arp_crc;
+static uint8_t i2c_code, i2c_lost, i2c_read, i2c_busy;
+static volatile uint8_t i2c_held;
+
+static uint8_t arp_byte(uint8_t n)
 {
-    if (timeout)
-        timeout--;
+    if (i2c_lost || n > ARP_UID)
+        return 0xff;
+    return n < ARP_UID ? UID[n] : arp_crc;
 }
 
-int receive_cmd(uint8_t *buf, uint16_t count)
+/* lets SCL go after ADDR */
+static void i2c_release(void)
 {
-    int i;
+    if (i2c_read)
+        I2C1->ISR = I2C_ISR_TXE;
+    I2C1->ICR = I2C_ICR_ADDRCF;
+}
 
-    I2C1->CR1 = 0;
-    while (I2C1->CR1 & I2C_CR1_PE);
+/* at a stop or a repeated start */
+static void i2c_end(void)
+{
+    i2c_busy = 0;
+    if (i2c_code == I2C_ARP_ADDR) {
+        if (!i2c_read && !arp_len && (i2c_count == ARP_FRAME ||
+            (i2c_count == 1 && arp_frame[0] == ARP_RESET))) {
+            arp_len = i2c_count;
+            Sched_Post(EV_ARP);
+        }
+    } else if (!i2c_code && !i2c_read && i2c_count == 4) {
+        uint8_t next = (i2c_head + 1) & (I2C_FRAMES - 1);
+        if (next != i2c_tail) {
+            i2c_head = next;
+            Sched_Post(EV_I2C);
+        }
+    }
+}
 
-    I2C1->CR1 = I2C_CR1_PE;
-    while ((I2C1->CR1 & I2C_CR1_PE) == 0);
+void I2C1_IRQHandler(void)
+{
+    uint32_t isr = I2C1->ISR;
 
-    I2C1->ICR = 0xffffffff;
+    if (isr & I2C_ISR_RXNE) {
+        uint8_t b = I2C1->RXDR;
+        if (i2c_code == I2C_ARP_ADDR) {
+            if (i2c_count < ARP_FRAME && !arp_len)
+                arp_frame[i2c_count] = b;
+        } else if (!i2c_code && i2c_count < 4)
+            i2c_frame[i2c_head][i2c_count] = b;
+        if (i2c_count < 0xff)
+            i2c_count++;
+    }
 
-    while ((I2C1->ISR & I2C_ISR_ADDR) == 0);
-    I2C1->ICR = I2C_ICR_ADDRCF;
+    if (isr & I2C_ISR_TXIS) {
+        if (i2c_code == I2C_ARP_ADDR)
+            I2C1->TXDR = arp_byte(i2c_count);
+        else if (!i2c_code && i2c_count < (int)sizeof(i2c_reply))
+            I2C1->TXDR = i2c_reply[i2c_count];
+        else
+            I2C1->TXDR = 0xff;
+        i2c_count++;
+    }
+
+    if (isr & I2C_ISR_ARLO)
+        i2c_lost = 1;
+
+    if (isr & (I2C_ISR_NACKF | I2C_ISR_BERR | I2C_ISR_ARLO | I2C_ISR_OVR))
+        I2C1->ICR = I2C_ICR_NACKCF | I2C_ICR_BERRCF | I2C_ICR_ARLOCF | I2C_ICR_OVRCF;
+
+    if (isr & I2C_ISR_STOPF) {
+        I2C1->ICR = I2C_ICR_STOPCF;
+        if (i2c_busy)
+            i2c_end();
+    }
 
-    if (I2C1->ISR & I2C_ISR_DIR) {
-        // read - not supported
-        return -1;
+    if ((isr & I2C_ISR_ADDR) && !i2c_held) {
+        if (i2c_busy)
+            i2c_end();
+        i2c_busy = 1;
+        i2c_count = 0;
+        i2c_read = (isr & I2C_ISR_DIR) != 0;
+        i2c_code = (isr & I2C_ISR_ADDCODE) >> I2C_ISR_ADDCODE_Pos;
+        i2c_lost = 0;
+        if (i2c_code == I2C_ARP_ADDR)
+            i2c_lost = Get_I2c_Addr() != 0;
+        else
+            i2c_code = 0;
+        if (!i2c_code && i2c_read && i2c_tail != i2c_head) {
+            /* i2c_task lets it go */
+            i2c_held = 1;
+            I2C1->CR1 &= ~I2C_CR1_ADDRIE;
+        } else
+            i2c_release();
     }
+}
 
-    timeout = 4;
-    for (i = 0; i < count; i++) {
-        while (((I2C1->ISR & I2C_ISR_RXNE) == 0) && (timeout));
-        if (!timeout)
-            return -2;
-        *buf++ = I2C1->RXDR;
+static void i2c_task(void)
+{
+    while (i2c_tail != i2c_head) {
+        user_i2c_proc(i2c_frame[i2c_tail]);
+        i2c_tail = (i2c_tail + 1) & (I2C_FRAMES - 1);
     }
+    /* a frame queued meanwhile posted EV_I2C again, the read waits for it */
+    __disable_irq();
+    if (i2c_held && i2c_tail == i2c_head) {
+        i2c_held = 0;
+        i2c_release();
+        I2C1->CR1 |= I2C_CR1_ADDRIE;
+    }
+    __enable_irq();
+}
 
-    while (((I2C1->ISR & I2C_ISR_STOPF) == 0) && (timeout));
-    if (!timeout)
-        return -2;
+/* an offset that leaves the valid range falls back to the straps alone */
+static void i2c_own_addr(void)
+{
+    uint8_t straps = I2C_BASE_ADDR + (GPIOF->IDR & 3);
+    uint8_t addr = Get_I2c_Addr();
 
-    I2C1->ICR = I2C_ICR_STOPCF;
-    return 0;
+    if (!addr)
+        addr = straps + Get_Addr_Offset();
+    if (!I2C_ADDR_VALID(addr))
+        addr = straps;
+    I2C1->OAR1 = 0;
+    I2C1->OAR1 = I2C_OAR1_OA1EN | addr << 1;
+}
+
+static void arp_task(void)
+{
+    uint8_t i;
+
+    if (arp_frame[0] == ARP_RESET) {
+        Set_I2c_Addr(0);
+    } else if (arp_frame[0] == ARP_ASSIGN) {
+        for (i = 0; i < ARP_UID && arp_frame[1 + i] == UID[i]; i++)
+            ;
+        if (i < ARP_UID) {
+            arp_len = 0;
+            return;
+        }
+        Set_I2c_Addr(arp_frame[1 + ARP_UID]);
+    }
+    Config_Save_Param(MOTOR_A, PARAM_I2C_ADDR);
+    i2c_own_addr();
+    arp_len = 0;
+}
+
+static void smbus_init(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < ARP_UID; i++)
+        arp_crc = Frame_Crc(arp_crc, UID[i]);
+    Sched_Task(EV_ARP, arp_task);
+}
+#endif
+
+static void tick_task(void)
+{
+    Failsafe_Tick();
+    Adc_Tick();
+    TB6612_Tick();
+    Alert_Tick();
+}
+
+void SysTick_Handler(void)
+{
+    Watchdog_Tick();
+    Gear_Tick();
+    Sched_Tick();
 }
 
 int main()
 {
+    Boot_Remap();
+    Watchdog_Init();
+
     RCC->AHBENR |= RCC_AHBENR_GPIOAEN;
-    RCC->APB1ENR |= RCC_APB1ENR_I2C1EN | RCC_APB1ENR_TIM3EN;
+    RCC->APB1ENR |= RCC_APB1ENR_TIM3EN;
 
     GPIOA->MODER |= MODER(MODE_OUT, PIN_AIN1) | MODER(MODE_OUT, PIN_AIN2) |
         MODER(MODE_OUT, PIN_BIN1) | MODER(MODE_OUT, PIN_BIN2) |
-        MODER(MODE_AF, PIN_SCL) | MODER(MODE_AF, PIN_SDA) |
         MODER(MODE_AF, PIN_PWMA) | MODER(MODE_AF, PIN_PWMB) |
         MODER(MODE_OUT, PIN_STBY);
 
     GPIOA->AFR[0] |= (1 << GPIO_AFRH_AFRH6_Pos) | (1 << GPIO_AFRH_AFRH7_Pos);
-    GPIOA->AFR[1] |= (4 << GPIO_AFRH_AFRH1_Pos) | (4 << GPIO_AFRH_AFRH2_Pos);
-
-    GPIOA->OTYPER |= GPIO_OTYPER_OT_9 | GPIO_OTYPER_OT_10;
-    GPIOA->PUPDR |= GPIO_PUPDR_PUPDR9_0 | GPIO_PUPDR_PUPDR10_0;
 
     RCC->AHBENR |= RCC_AHBENR_GPIOFEN;
     GPIOF->MODER  |= MODER(MODE_IN, 0) | MODER(MODE_IN, 1);
     GPIOF->PUPDR  |= GPIO_PUPDR_PUPDR0_0 | GPIO_PUPDR_PUPDR1_0;
-    I2C1->OAR1 = I2C_OAR1_OA1EN | ((I2C_BASE_ADDR + (GPIOF->IDR & 3)) << 1);
-    
-    I2C1->CR1 = I2C_CR1_PE;
 
     TIM3->CCMR1 = TIM_CCMR1_OC1PE | TIM_CCMR1_OC1M_2 | TIM_CCMR1_OC1M_1 |
         TIM_CCMR1_OC2PE | TIM_CCMR1_OC2M_2 | TIM_CCMR1_OC2M_1;
@@ -85,15 +279,56 @@ int main()
     TIM3->ARR = 8000 - 1;
     TIM3->EGR = TIM_EGR_UG;
     TIM3->CR1 = TIM_CR1_ARPE | TIM_CR1_CEN;
+    NVIC_EnableIRQ(TIM3_IRQn);
+
+    Adc_Init();
 
+    /* stored configuration before the first command */
+    Config_Load();
+#ifdef TRANSPORT_UART
+    Uart_Init(EV_UART);
+    Sched_Task(EV_UART, uart_task);
+#else
+    RCC->APB1ENR |= RCC_APB1ENR_I2C1EN;
+    GPIOA->MODER |= MODER(MODE_AF, PIN_SCL) | MODER(MODE_AF, PIN_SDA);
+    GPIOA->AFR[1] |= (4 << GPIO_AFRH_AFRH1_Pos) | (4 << GPIO_AFRH_AFRH2_Pos);
+    GPIOA->OTYPER |= GPIO_OTYPER_OT_9 | GPIO_OTYPER_OT_10;
+    GPIOA->PUPDR |= GPIO_PUPDR_PUPDR9_0 | GPIO_PUPDR_PUPDR10_0;
+
+    i2c_own_addr();
+    smbus_init();
+    I2C1->OAR2 = I2C_OAR2_OA2EN | I2C_ARP_ADDR << 1;
+
+    I2C1->CR1 = I2C_CR1_PE | I2C_CR1_ADDRIE | I2C_CR1_RXIE | I2C_CR1_TXIE |
+        I2C_CR1_STOPIE | I2C_CR1_NACKIE | I2C_CR1_ERRIE;
+    NVIC_EnableIRQ(I2C1_IRQn);
+    Sched_Task(EV_I2C, i2c_task);
+#endif
+
+    Sched_Task(EV_TICK, tick_task);
+    Sched_Every(EV_TICK, 1);
+    Sched_Set_Clock(8000);
     SysTick_Config(8000);
+    /* up from the lowest, the gearing loop goes first when several are pending */
+    NVIC_SetPriority(SysTick_IRQn, 0);
 
     while (1)
     {
-        uint8_t cmd[4];
-        int rc = receive_cmd(cmd, sizeof(cmd));
-        if (rc == 0)
-            user_i2c_proc(cmd);
+        Watchdog_Checkin(WDG_MAIN);
+        if (Sched_Dispatch())
+            continue;
+
+        /* sleep, the wake-up interrupt runs after the time is taken */
+        __disable_irq();
+        if (!Sched_Pending()) {
+            uint32_t t0 = SysTick->VAL, t;
+            __WFI();
+            t = t0 - SysTick->VAL;
+            if ((int32_t)t < 0)
+                t += SysTick->LOAD + 1;
+            Sched_Idle(t);
+        }
+        __enable_irq();
     }
 
     return 0;
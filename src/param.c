@@ -0,0 +1,283 @@
+#include "stm32f030x6.h"
+#include "param.h"
+#include "spare.h"
+#include "gear.h"
+#include "drive.h"
+#include "tb6612.h"
+#include "adc.h"
+#include "failsafe.h"
+#include "watchdog.h"
+#include "sched.h"
+#include "config.h"
+#include "alert.h"
+
+void Set_Param(uint8_t motor, uint8_t id, uint16_t value)
+{
+    if (id >= PARAM_LUT_0 && id < PARAM_LUT_0 + LUT_POINTS)
+    {
+        Set_TB6612_Lut(motor, id - PARAM_LUT_0, value);
+        return;
+    }
+
+    switch (id)
+    {
+        case PARAM_PA5_FUNC:
+            Set_Spare_Func(SPARE_PA5, value);
+        break;
+
+        case PARAM_PB1_FUNC:
+            Set_Spare_Func(SPARE_PB1, value);
+        break;
+
+        case PARAM_ADDR_OFFSET:
+            Set_Addr_Offset(value);
+        break;
+
+        case PARAM_I2C_ADDR:
+            Set_I2c_Addr(value);
+        break;
+
+        case PARAM_GEAR_ENABLE:
+            Gear_Enable(value != 0);
+        break;
+
+        case PARAM_GEAR_RATIO:
+            Gear_Set_Ratio((int16_t)value);
+        break;
+
+        case PARAM_GEAR_KP:
+            Gear_Set_Gain(value);
+        break;
+
+        case PARAM_DRIVE_TRACK:
+            Drive_Set_Track(value);
+        break;
+
+        case PARAM_DRIVE_SCALE:
+            Drive_Set_Scale(value);
+        break;
+
+        case PARAM_DRIVE_INVERT:
+            Drive_Set_Invert(value);
+        break;
+
+        case PARAM_LUT_ENABLE:
+            Enable_TB6612_Lut(motor, value != 0);
+        break;
+
+        case PARAM_KICK_PULSE:
+            Set_TB6612_Kick(motor, value, Get_TB6612_Kick_Periods(motor));
+        break;
+
+        case PARAM_KICK_PERIODS:
+            Set_TB6612_Kick(motor, Get_TB6612_Kick_Pulse(motor), value);
+        break;
+
+        case PARAM_REV_PERIODS:
+            Set_TB6612_Reverse(motor, value, Get_TB6612_Reverse_Ramp(motor),
+                Get_TB6612_Reverse_Brake(motor));
+        break;
+
+        case PARAM_REV_RAMP:
+            Set_TB6612_Reverse(motor, Get_TB6612_Reverse_Periods(motor), value,
+                Get_TB6612_Reverse_Brake(motor));
+        break;
+
+        case PARAM_REV_BRAKE:
+            Set_TB6612_Reverse(motor, Get_TB6612_Reverse_Periods(motor),
+                Get_TB6612_Reverse_Ramp(motor), value);
+        break;
+
+        case PARAM_VSENSE_SCALE:
+            Set_Vsense_Scale(value);
+        break;
+
+        case PARAM_VCOMP_NOMINAL:
+            Set_Vcomp_Nominal(value);
+        break;
+
+        case PARAM_HOLD_DELAY:
+            Set_TB6612_Hold(motor, value, Get_TB6612_Hold_Scale(motor));
+        break;
+
+        case PARAM_HOLD_SCALE:
+            Set_TB6612_Hold(motor, Get_TB6612_Hold_Delay(motor), value);
+        break;
+
+        case PARAM_TEMP_LIMIT:
+            Set_Temp_Limit(value, Get_Temp_Span());
+        break;
+
+        case PARAM_TEMP_SPAN:
+            Set_Temp_Limit(Get_Temp_Limit(), value);
+        break;
+
+        case PARAM_UVLO_MV:
+            Set_Uvlo(value, Get_Uvlo_Hyst());
+        break;
+
+        case PARAM_UVLO_HYST:
+            Set_Uvlo(Get_Uvlo_Mv(), value);
+        break;
+
+        case PARAM_UVLO_FAULT:
+            Clear_Uvlo_Latch();
+        break;
+
+        case PARAM_FS_TIMEOUT:
+            Failsafe_Set(value, Failsafe_Get_Action(), Failsafe_Get_Ramp());
+        break;
+
+        case PARAM_FS_ACTION:
+            Failsafe_Set(Failsafe_Get_Timeout(), value, Failsafe_Get_Ramp());
+        break;
+
+        case PARAM_FS_RAMP:
+            Failsafe_Set(Failsafe_Get_Timeout(), Failsafe_Get_Action(), value);
+        break;
+
+        case PARAM_ALERT_MASK:
+            Alert_Set_Mask(value);
+        break;
+
+        case PARAM_ALERT_EVENTS:
+            Alert_Clear(value);
+        break;
+    }
+}
+
+int32_t Get_Param(uint8_t motor, uint8_t id)
+{
+    if (id >= PARAM_LUT_0 && id < PARAM_LUT_0 + LUT_POINTS)
+        return Get_TB6612_Lut(motor, id - PARAM_LUT_0);
+
+    switch (id)
+    {
+        case PARAM_PA5_FUNC:
+            return Get_Spare_Func(SPARE_PA5);
+
+        case PARAM_PB1_FUNC:
+            return Get_Spare_Func(SPARE_PB1);
+
+        case PARAM_ADDR_OFFSET:
+            return Get_Addr_Offset();
+
+        case PARAM_I2C_ADDR:
+            return Get_I2c_Addr();
+
+        case PARAM_GEAR_ENABLE:
+            return Gear_Enabled();
+
+        case PARAM_GEAR_RATIO:
+            return Gear_Get_Ratio();
+
+        case PARAM_GEAR_KP:
+            return Gear_Get_Gain();
+
+        case PARAM_DRIVE_TRACK:
+            return Drive_Get_Track();
+
+        case PARAM_DRIVE_SCALE:
+            return Drive_Get_Scale();
+
+        case PARAM_DRIVE_INVERT:
+            return Drive_Get_Invert();
+
+        case PARAM_LUT_ENABLE:
+            return Get_TB6612_Lut_Enabled(motor);
+
+        case PARAM_KICK_PULSE:
+            return Get_TB6612_Kick_Pulse(motor);
+
+        case PARAM_KICK_PERIODS:
+            return Get_TB6612_Kick_Periods(motor);
+
+        case PARAM_REV_PERIODS:
+            return Get_TB6612_Reverse_Periods(motor);
+
+        case PARAM_REV_RAMP:
+            return Get_TB6612_Reverse_Ramp(motor);
+
+        case PARAM_REV_BRAKE:
+            return Get_TB6612_Reverse_Brake(motor);
+
+        case PARAM_VSENSE_SCALE:
+            return Get_Vsense_Scale();
+
+        case PARAM_VCOMP_NOMINAL:
+            return Get_Vcomp_Nominal();
+
+        case PARAM_HOLD_DELAY:
+            return Get_TB6612_Hold_Delay(motor);
+
+        case PARAM_HOLD_SCALE:
+            return Get_TB6612_Hold_Scale(motor);
+
+        case PARAM_TEMP_LIMIT:
+            return Get_Temp_Limit();
+
+        case PARAM_TEMP_SPAN:
+            return Get_Temp_Span();
+
+        case PARAM_UVLO_MV:
+            return Get_Uvlo_Mv();
+
+        case PARAM_UVLO_HYST:
+            return Get_Uvlo_Hyst();
+
+        case PARAM_UVLO_FAULT:
+            return Get_Uvlo_State();
+
+        case PARAM_FS_TIMEOUT:
+            return Failsafe_Get_Timeout();
+
+        case PARAM_FS_ACTION:
+            return Failsafe_Get_Action();
+
+        case PARAM_FS_RAMP:
+            return Failsafe_Get_Ramp();
+
+        case PARAM_ALERT_MASK:
+            return Alert_Get_Mask();
+
+        case PARAM_ALERT_EVENTS:
+            return Alert_Events();
+
+        case PARAM_TACH:
+            return Get_Tach_Count(motor);
+
+        case PARAM_VSUPPLY:
+            return Get_Vsupply();
+
+        case PARAM_TEMP:
+            return Get_Temp();
+
+        case PARAM_DERATE:
+            return Get_Therm_Limit();
+
+        case PARAM_ADC_VSENSE:
+            return Get_Adc_Avg(ADC_AVG_VSENSE);
+
+        case PARAM_ADC_TEMP:
+            return Get_Adc_Avg(ADC_AVG_TEMP);
+
+        case PARAM_ADC_VREF:
+            return Get_Adc_Avg(ADC_AVG_VREF);
+
+        case PARAM_VDDA:
+            return Get_Vdda();
+
+        case PARAM_FS_ACTIVE:
+            return Failsafe_Active();
+
+        case PARAM_RESET_CAUSE:
+            return Get_Reset_Cause();
+
+        case PARAM_RESET_COUNT:
+            return Get_Reset_Count();
+
+        case PARAM_CPU_LOAD:
+            return Sched_Load();
+    }
+    return 0;
+}
@@ -0,0 +1,78 @@
+#ifndef __PARAM_H
+#define __PARAM_H
+
+#include <stdint.h>
+
+/* board */
+#define PARAM_PA5_FUNC          0x00
+#define PARAM_PB1_FUNC          0x01
+#define PARAM_ADDR_OFFSET       0x02    /* added to the address, at next reset */
+#define PARAM_I2C_ADDR          0x03    /* assigned address, 0 = straps, at next reset */
+
+/* electronic gearing, B follows A */
+#define PARAM_GEAR_ENABLE       0x08
+#define PARAM_GEAR_RATIO        0x09
+#define PARAM_GEAR_KP           0x0a
+
+/* differential drive */
+#define PARAM_DRIVE_TRACK       0x10
+#define PARAM_DRIVE_SCALE       0x11
+#define PARAM_DRIVE_INVERT      0x12
+
+/* per motor duty linearization, points are Q12 fractions of the period */
+#define PARAM_LUT_ENABLE        0x18
+#define PARAM_LUT_0             0x20    /* .. PARAM_LUT_0 + LUT_POINTS - 1 */
+
+/* per motor kick-start from rest, pulse in timer ticks */
+#define PARAM_KICK_PULSE        0x38
+#define PARAM_KICK_PERIODS      0x39
+
+/* supply sense on PA5, mV at ADC full scale, and compensation target mV */
+#define PARAM_VSENSE_SCALE      0x40
+#define PARAM_VCOMP_NOMINAL     0x41
+
+/* per motor hold reduction, delay in ms (0 = off), scale in Q12 */
+#define PARAM_HOLD_DELAY        0x50
+#define PARAM_HOLD_SCALE        0x51
+
+/* thermal derating, in 0.1 C (limit 0 = off) */
+#define PARAM_TEMP_LIMIT        0x58
+#define PARAM_TEMP_SPAN         0x59
+
+/* VDDA undervoltage lockout in mV (0 = off), write fault to clear latch */
+#define PARAM_UVLO_MV           0x60
+#define PARAM_UVLO_HYST         0x61
+#define PARAM_UVLO_FAULT        0x62    /* bit 0 active, bit 1 latched */
+
+/* per motor reversal sequence, in PWM periods (0 = direct reversal) */
+#define PARAM_REV_PERIODS       0x68    /* brake or coast before the new polarity */
+#define PARAM_REV_RAMP          0x69    /* ramp up of the new polarity */
+#define PARAM_REV_BRAKE         0x6a    /* 1 brake, 0 coast */
+
+/* command silence failsafe, board wide, timeout in ms (0 = off) */
+#define PARAM_FS_TIMEOUT        0x70
+#define PARAM_FS_ACTION         0x71    /* coast, brake, ramp, standby */
+#define PARAM_FS_RAMP           0x72    /* ms to zero for the ramp action */
+
+/* host alert line on a FUNC_ALERT spare pin, ALERT_ bits of alert.h */
+#define PARAM_ALERT_MASK        0x78    /* events that pull the line */
+#define PARAM_ALERT_EVENTS      0x79    /* latched events, write bits to clear */
+
+/* read only */
+#define PARAM_TACH              0x80
+#define PARAM_VSUPPLY           0x81
+#define PARAM_TEMP              0x86    /* 0.1 C */
+#define PARAM_DERATE            0x87    /* duty limit, Q12 */
+#define PARAM_ADC_VSENSE        0x88    /* filtered raw ADC averages */
+#define PARAM_ADC_TEMP          0x89
+#define PARAM_ADC_VREF          0x8a
+#define PARAM_VDDA              0x8b    /* mV */
+#define PARAM_FS_ACTIVE         0x8c
+#define PARAM_RESET_CAUSE       0x8d    /* RCC_CSR bits 31..24 at boot */
+#define PARAM_RESET_COUNT       0x8e    /* resets since power on */
+#define PARAM_CPU_LOAD          0x8f    /* busy share of the last second, 0.1 % */
+
+extern void Set_Param(uint8_t motor, uint8_t id, uint16_t value);
+extern int32_t Get_Param(uint8_t motor, uint8_t id);
+
+#endif
@@ -0,0 +1,226 @@
+#include "sched.h"
+
+/*
+ * Run to completion scheduler.
+ *
+ * An event is a pending byte, Sched_Post() from any interrupt sets it with
+ * a single store and Sched_Dispatch() in the main loop clears it before
+ * running the task, so a post during the task runs it again and nothing
+ * needs locking. Posts of an event that is still pending coalesce.
+ *
+ * Periodic events live in a timer wheel advanced by Sched_Tick(), each
+ * tick only walks the timers of one slot. Timers are set up with
+ * Sched_Every() before the tick starts. Sched_After() arms a one shot
+ * timer at any time: it only stores the delay and a flag, the next tick
+ * moves the timer into the wheel, so it needs no locking either. Nothing
+ * here touches hardware, the tick can be driven by any clock, see
+ * tools/sched_test.c.
+ *
+ * The main loop reports the cycles it slept with Sched_Idle(), the load
+ * is the busy share of the last SCHED_LOAD_WINDOW ticks in 0.1 %.
+ */
+
+#define SCHED_NONE              0xff
+
+static sched_fn sched_task[SCHED_EVENTS];
+static volatile uint8_t sched_pending[SCHED_EVENTS];
+
+static uint8_t timer_ev[SCHED_TIMERS];
+static uint16_t timer_period[SCHED_TIMERS];
+static uint32_t timer_expire[SCHED_TIMERS];
+static uint8_t timer_next[SCHED_TIMERS];
+static volatile uint16_t timer_delay[SCHED_TIMERS];
+static volatile uint8_t timer_arm[SCHED_TIMERS];
+static uint8_t timer_queued[SCHED_TIMERS];
+static uint8_t timer_count;
+static uint8_t wheel[SCHED_WHEEL] = {
+    SCHED_NONE, SCHED_NONE, SCHED_NONE, SCHED_NONE,
+    SCHED_NONE, SCHED_NONE, SCHED_NONE, SCHED_NONE,
+};
+static volatile uint32_t sched_now;
+
+static uint32_t tick_cycles = SCHED_LOAD_WINDOW;
+static volatile uint32_t idle_cycles;
+static uint16_t load_ticks;
+static volatile uint16_t sched_load;
+
+static void wheel_insert(uint8_t t)
+{
+    uint8_t slot = timer_expire[t] & (SCHED_WHEEL - 1);
+
+    timer_next[t] = wheel[slot];
+    wheel[slot] = t;
+    timer_queued[t] = 1;
+}
+
+static void wheel_remove(uint8_t t)
+{
+    uint8_t *link = &wheel[timer_expire[t] & (SCHED_WHEEL - 1)];
+
+    while (*link != SCHED_NONE)
+    {
+        if (*link == t)
+        {
+            *link = timer_next[t];
+            break;
+        }
+        link = &timer_next[*link];
+    }
+    timer_queued[t] = 0;
+}
+
+/* one shot timers armed since the last tick, due delay ticks after the call */
+static void wheel_arm(uint32_t now)
+{
+    uint16_t delay;
+    uint8_t t;
+
+    for (t = 0; t < timer_count; t++)
+    {
+        if (!timer_arm[t])
+            continue;
+        timer_arm[t] = 0;
+        delay = timer_delay[t];
+        if (timer_queued[t])
+            wheel_remove(t);
+        timer_expire[t] = now - 1 + (delay ? delay : 1);
+        wheel_insert(t);
+    }
+}
+
+void Sched_Task(uint8_t ev, sched_fn fn)
+{
+    if (ev < SCHED_EVENTS)
+        sched_task[ev] = fn;
+}
+
+void Sched_Every(uint8_t ev, uint16_t period)
+{
+    uint8_t t = timer_count;
+
+    if (t >= SCHED_TIMERS || period == 0)
+        return;
+
+    timer_ev[t] = ev;
+    timer_period[t] = period;
+    timer_expire[t] = sched_now + period;
+    wheel_insert(t);
+    timer_count++;
+}
+
+/* arming it again before it is due moves it, the event is posted once */
+void Sched_After(uint8_t ev, uint16_t delay)
+{
+    uint8_t t;
+
+    for (t = 0; t < timer_count; t++)
+        if (timer_ev[t] == ev && timer_period[t] == 0)
+            break;
+    if (t == timer_count)
+    {
+        /* a new one shot, only from the context that set up the timers */
+        if (t >= SCHED_TIMERS)
+            return;
+        timer_ev[t] = ev;
+        timer_period[t] = 0;
+        timer_count++;
+    }
+    timer_delay[t] = delay;
+    timer_arm[t] = 1;
+}
+
+void Sched_Post(uint8_t ev)
+{
+    if (ev < SCHED_EVENTS)
+        sched_pending[ev] = 1;
+}
+
+uint8_t Sched_Pending(void)
+{
+    uint8_t ev;
+
+    for (ev = 0; ev < SCHED_EVENTS; ev++)
+        if (sched_pending[ev])
+            return 1;
+    return 0;
+}
+
+/* runs every pending task once, returns the number run */
+uint8_t Sched_Dispatch(void)
+{
+    uint8_t ev, n = 0;
+
+    for (ev = 0; ev < SCHED_EVENTS; ev++)
+    {
+        if (!sched_pending[ev])
+            continue;
+        sched_pending[ev] = 0;
+        if (sched_task[ev])
+            sched_task[ev]();
+        n++;
+    }
+    return n;
+}
+
+void Sched_Tick(void)
+{
+    uint32_t now = ++sched_now;
+    uint8_t slot = now & (SCHED_WHEEL - 1);
+    uint8_t t, next, *link = &wheel[slot];
+    uint32_t idle;
+
+    if (++load_ticks == SCHED_LOAD_WINDOW)
+    {
+        /* window cycles / 1000 = tick_cycles */
+        idle = idle_cycles / (tick_cycles * SCHED_LOAD_WINDOW / 1000);
+        idle_cycles = 0;
+        load_ticks = 0;
+        sched_load = idle >= 1000 ? 0 : 1000 - idle;
+    }
+
+    wheel_arm(now);
+    t = wheel[slot];
+
+    while (t != SCHED_NONE)
+    {
+        next = timer_next[t];
+        if (timer_expire[t] == now)
+        {
+            Sched_Post(timer_ev[t]);
+            *link = next;
+            timer_queued[t] = 0;
+            if (timer_period[t])
+            {
+                timer_expire[t] += timer_period[t];
+                wheel_insert(t);
+                if (link == &wheel[slot] && wheel[slot] == t)
+                    link = &timer_next[t];
+            }
+        }
+        else
+            link = &timer_next[t];
+        t = next;
+    }
+}
+
+uint32_t Sched_Now(void)
+{
+    return sched_now;
+}
+
+/* cycles per tick, for the load */
+void Sched_Set_Clock(uint32_t cycles)
+{
+    tick_cycles = cycles;
+}
+
+/* called with interrupts disabled, or from the tick context */
+void Sched_Idle(uint32_t cycles)
+{
+    idle_cycles += cycles;
+}
+
+uint16_t Sched_Load(void)
+{
+    return sched_load;
+}
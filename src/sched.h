@@ -0,0 +1,25 @@
+#ifndef __SCHED_H
+#define __SCHED_H
+
+#include <stdint.h>
+
+#define SCHED_EVENTS            8
+#define SCHED_TIMERS            4
+#define SCHED_WHEEL             8       /* slots, power of two */
+#define SCHED_LOAD_WINDOW       1000    /* ticks */
+
+typedef void (*sched_fn)(void);
+
+extern void Sched_Task(uint8_t ev, sched_fn fn);
+extern void Sched_Every(uint8_t ev, uint16_t period);
+extern void Sched_After(uint8_t ev, uint16_t delay);
+extern void Sched_Post(uint8_t ev);
+extern uint8_t Sched_Pending(void);
+extern uint8_t Sched_Dispatch(void);
+extern void Sched_Tick(void);
+extern uint32_t Sched_Now(void);
+extern void Sched_Set_Clock(uint32_t cycles);
+extern void Sched_Idle(uint32_t cycles);
+extern uint16_t Sched_Load(void);
+
+#endif
@@ -0,0 +1,105 @@
+#include "stm32f030x6.h"
+#include "spare.h"
+#include "tb6612.h"
+
+/*
+ * PA5 and PB1 are not used by the shield and are free for optional
+ * functions. As tachometer inputs PA5 counts motor A and PB1 motor B,
+ * one count per rising edge (pulled up for open collector sensors),
+ * signed by the last driven direction. PA5 can also be the motor supply
+ * sense input, ADC channel 5, see adc.c. Either pin can be the open
+ * drain host alert output, see alert.c.
+ */
+
+static const uint8_t spare_allowed[2] = {
+    (1 << FUNC_NONE) | (1 << FUNC_TACH) | (1 << FUNC_VSENSE) |
+        (1 << FUNC_ALERT),
+    (1 << FUNC_NONE) | (1 << FUNC_TACH) | (1 << FUNC_ALERT),
+};
+
+static uint8_t spare_func[2];
+static volatile int32_t tach_count[2];
+
+static void exti_enable(uint8_t line, uint8_t on)
+{
+    if (on)
+    {
+        EXTI->RTSR |= 1u << line;
+        EXTI->IMR |= 1u << line;
+    }
+    else
+    {
+        EXTI->IMR &= ~(1u << line);
+        EXTI->RTSR &= ~(1u << line);
+    }
+    EXTI->PR = 1u << line;
+}
+
+static void tach_edge(uint8_t motor)
+{
+    static int8_t sign[2] = { 1, 1 };
+    uint8_t dir = Get_TB6612_Dir(motor);
+
+    if (dir == DIR_CW)
+        sign[motor] = 1;
+    else if (dir == DIR_CCW)
+        sign[motor] = -1;
+    tach_count[motor] += sign[motor];
+}
+
+void Set_Spare_Func(uint8_t pin, uint8_t func)
+{
+    GPIO_TypeDef *port = pin == SPARE_PA5 ? GPIOA : GPIOB;
+    uint8_t line = pin == SPARE_PA5 ? PIN_SPARE1 : PIN_SPARE2;
+
+    if (func > 7 || (spare_allowed[pin] & (1 << func)) == 0)
+        return;
+
+    RCC->APB2ENR |= RCC_APB2ENR_SYSCFGEN;
+    RCC->AHBENR |= RCC_AHBENR_GPIOBEN;
+    spare_func[pin] = func;
+
+    port->MODER &= ~MODER(MODE_AN, line);
+    port->PUPDR &= ~(GPIO_PUPDR_PUPDR0 << (2 * line));
+    port->OTYPER &= ~(1u << line);
+    if (func == FUNC_TACH)
+        port->PUPDR |= GPIO_PUPDR_PUPDR0_0 << (2 * line);
+    else if (func == FUNC_VSENSE)
+        port->MODER |= MODER(MODE_AN, line);
+    else if (func == FUNC_ALERT)
+    {
+        port->BSRR = 1u << line;
+        port->OTYPER |= 1u << line;
+        port->MODER |= MODER(MODE_OUT, line);
+    }
+
+    if (pin == SPARE_PB1)
+        SYSCFG->EXTICR[0] = (SYSCFG->EXTICR[0] & ~SYSCFG_EXTICR1_EXTI1) |
+            SYSCFG_EXTICR1_EXTI1_PB;
+    exti_enable(line, func == FUNC_TACH);
+    NVIC_EnableIRQ(pin == SPARE_PA5 ? EXTI4_15_IRQn : EXTI0_1_IRQn);
+}
+
+uint8_t Get_Spare_Func(uint8_t pin)
+{
+    return spare_func[pin];
+}
+
+int32_t Get_Tach_Count(uint8_t motor)
+{
+    return tach_count[motor];
+}
+
+void EXTI0_1_IRQHandler(void)
+{
+    EXTI->PR = 1u << PIN_SPARE2;
+    if (spare_func[SPARE_PB1] == FUNC_TACH)
+        tach_edge(MOTOR_B);
+}
+
+void EXTI4_15_IRQHandler(void)
+{
+    EXTI->PR = 1u << PIN_SPARE1;
+    if (spare_func[SPARE_PA5] == FUNC_TACH)
+        tach_edge(MOTOR_A);
+}
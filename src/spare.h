@@ -0,0 +1,18 @@
+#ifndef __SPARE_H
+#define __SPARE_H
+
+#include <stdint.h>
+
+#define SPARE_PA5               0
+#define SPARE_PB1               1
+
+#define FUNC_NONE               0x00
+#define FUNC_TACH               0x01
+#define FUNC_VSENSE             0x02    /* PA5 only */
+#define FUNC_ALERT              0x05    /* open drain alert output, see alert.c */
+
+extern void Set_Spare_Func(uint8_t pin, uint8_t func);
+extern uint8_t Get_Spare_Func(uint8_t pin);
+extern int32_t Get_Tach_Count(uint8_t motor);
+
+#endif
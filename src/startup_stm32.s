@@ -123,84 +123,34 @@ g_pfnVectors:
 	.word	0
 	.word	PendSV_Handler
 	.word	SysTick_Handler
+	.word	WWDG_IRQHandler
 	.word	0
+	.word	RTC_IRQHandler
+	.word	FLASH_IRQHandler
+	.word	RCC_IRQHandler
+	.word	EXTI0_1_IRQHandler
+	.word	EXTI2_3_IRQHandler
+	.word	EXTI4_15_IRQHandler
 	.word	0
+	.word	DMA1_Channel1_IRQHandler
+	.word	DMA1_Channel2_3_IRQHandler
+	.word	DMA1_Channel4_5_IRQHandler
+	.word	ADC1_IRQHandler
+	.word	TIM1_BRK_UP_TRG_COM_IRQHandler
+	.word	TIM1_CC_IRQHandler
 	.word	0
+	.word	TIM3_IRQHandler
 	.word	0
 	.word	0
+	.word	TIM14_IRQHandler
 	.word	0
+	.word	TIM16_IRQHandler
+	.word	TIM17_IRQHandler
+	.word	I2C1_IRQHandler
 	.word	0
+	.word	SPI1_IRQHandler
 	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
-	.word	0
+	.word	USART1_IRQHandler
 	.word	0
 	.word	0
 	.word	0
@@ -241,6 +191,66 @@ g_pfnVectors:
 	.weak	SysTick_Handler
 	.thumb_set SysTick_Handler,Default_Handler
 
+	.weak	WWDG_IRQHandler
+	.thumb_set WWDG_IRQHandler,Default_Handler
+
+	.weak	RTC_IRQHandler
+	.thumb_set RTC_IRQHandler,Default_Handler
+
+	.weak	FLASH_IRQHandler
+	.thumb_set FLASH_IRQHandler,Default_Handler
+
+	.weak	RCC_IRQHandler
+	.thumb_set RCC_IRQHandler,Default_Handler
+
+	.weak	EXTI0_1_IRQHandler
+	.thumb_set EXTI0_1_IRQHandler,Default_Handler
+
+	.weak	EXTI2_3_IRQHandler
+	.thumb_set EXTI2_3_IRQHandler,Default_Handler
+
+	.weak	EXTI4_15_IRQHandler
+	.thumb_set EXTI4_15_IRQHandler,Default_Handler
+
+	.weak	DMA1_Channel1_IRQHandler
+	.thumb_set DMA1_Channel1_IRQHandler,Default_Handler
+
+	.weak	DMA1_Channel2_3_IRQHandler
+	.thumb_set DMA1_Channel2_3_IRQHandler,Default_Handler
+
+	.weak	DMA1_Channel4_5_IRQHandler
+	.thumb_set DMA1_Channel4_5_IRQHandler,Default_Handler
+
+	.weak	ADC1_IRQHandler
+	.thumb_set ADC1_IRQHandler,Default_Handler
+
+	.weak	TIM1_BRK_UP_TRG_COM_IRQHandler
+	.thumb_set TIM1_BRK_UP_TRG_COM_IRQHandler,Default_Handler
+
+	.weak	TIM1_CC_IRQHandler
+	.thumb_set TIM1_CC_IRQHandler,Default_Handler
+
+	.weak	TIM3_IRQHandler
+	.thumb_set TIM3_IRQHandler,Default_Handler
+
+	.weak	TIM14_IRQHandler
+	.thumb_set TIM14_IRQHandler,Default_Handler
+
+	.weak	TIM16_IRQHandler
+	.thumb_set TIM16_IRQHandler,Default_Handler
+
+	.weak	TIM17_IRQHandler
+	.thumb_set TIM17_IRQHandler,Default_Handler
+
+	.weak	I2C1_IRQHandler
+	.thumb_set I2C1_IRQHandler,Default_Handler
+
+	.weak	SPI1_IRQHandler
+	.thumb_set SPI1_IRQHandler,Default_Handler
+
+	.weak	USART1_IRQHandler
+	.thumb_set USART1_IRQHandler,Default_Handler
+
 	.weak	SystemInit
 
 /************************ (C) COPYRIGHT Ac6 *****END OF FILE****/
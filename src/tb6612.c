@@ -1,17 +1,399 @@
 #include "stm32f030x6.h"
 #include "tb6612.h"
 
-#define pin_set(pin)        GPIOA->BSRR = 1u << (pin)
 #define pin_clear(pin)      GPIOA->BRR = 1u << (pin)
+#define pin_hi(pin)         (1u << (pin))
+#define pin_lo(pin)         (1u << ((pin) + 16))
 #define pwm_a(pulse)        TIM3->CCR1 = (pulse)
 #define pwm_b(pulse)        TIM3->CCR2 = (pulse)
 
+static uint8_t motor_dir[2] = { DIR_STANDBY, DIR_STANDBY };
+static uint16_t motor_pulse[2];
+static volatile uint8_t inhibit;
+
+/*
+ * Duty linearization, LUT_POINTS breakpoints per motor evenly spaced over
+ * the PWM period, values are fractions of the period in Q12. The command
+ * is mapped onto the table with a reciprocal of the period that is only
+ * recomputed after a frequency change, so the hot path has no division.
+ */
+#define LUT_FULL                (1u << 12)
+#define LUT_IDENTITY            { 0, 256, 512, 768, 1024, 1280, 1536, 1792, 2048, \
+                                  2304, 2560, 2816, 3072, 3328, 3584, 3840, 4096 }
+
+static uint8_t lut_on[2];
+static uint16_t lut[2][LUT_POINTS] = { LUT_IDENTITY, LUT_IDENTITY };
+static uint32_t lut_recip;
+static uint32_t lut_period;
+
+static uint16_t linearize(uint8_t motor, uint16_t pulse, uint32_t period)
+{
+    uint32_t t, frac, i;
+    int32_t y;
+
+    if (period != lut_period)
+    {
+        lut_period = period;
+        lut_recip = (1ul << 24) / period;
+    }
+
+    t = pulse * lut_recip;
+    i = t >> 20;
+    if (i >= LUT_POINTS - 1)
+        y = lut[motor][LUT_POINTS - 1];
+    else
+    {
+        frac = (t >> 4) & 0xffff;
+        y = lut[motor][i] +
+            (((int32_t)(lut[motor][i + 1] - lut[motor][i]) * (int32_t)frac) >> 16);
+    }
+    return (y * period) >> 12;
+}
+
+/*
+ * Output scale, per motor product of the Q12 factors of all sources
+ * (supply compensation, hold reduction, failsafe ramp) applied after the
+ * table, then clamped to the duty limit (thermal derating).
+ */
+static uint16_t scale_src[SCALE_SOURCES][2] = {
+    { SCALE_ONE, SCALE_ONE },
+    { SCALE_ONE, SCALE_ONE },
+    { SCALE_ONE, SCALE_ONE },
+};
+static uint16_t out_scale[2] = { SCALE_ONE, SCALE_ONE };
+static uint16_t out_limit = SCALE_ONE;
+
+static uint16_t scale(uint8_t motor, uint16_t pulse, uint32_t period)
+{
+    uint32_t out = ((uint32_t)pulse * out_scale[motor]) >> 12;
+    uint32_t max = (period * out_limit) >> 12;
+
+    return out > max ? max : out;
+}
+
+static uint16_t shape(uint8_t motor, uint16_t pulse)
+{
+    uint32_t period = TIM3->ARR + 1;
+
+    if (pulse == 0)
+        return 0;
+    if (pulse > period)
+        pulse = period;
+    if (lut_on[motor])
+        pulse = linearize(motor, pulse, period);
+
+    return scale(motor, pulse, period);
+}
+
+/*
+ * Kick-start, a start from rest with a pulse below kick_pulse is driven at
+ * kick_pulse for kick_periods PWM periods first. The TIM3 update interrupt
+ * is only enabled while a kick or a proportional brake is running.
+ */
+static uint16_t kick_pulse[2];
+static uint16_t kick_periods[2];
+static volatile uint16_t kick_left[2];
+
+/*
+ * Reversal sequencing, a CW/CCW change while driving first drops the PWM
+ * to zero at the next update, then holds the bridge in brake or coast for
+ * rev_periods PWM periods and ramps the new polarity up over rev_ramp
+ * periods. It is run from the TIM3 update interrupt, rev_periods 0 keeps
+ * the direct reversal.
+ */
+#define REV_IDLE                0
+#define REV_ZERO                1
+#define REV_HOLD                2
+#define REV_RAMP                3
+
+static uint16_t rev_periods[2];
+static uint16_t rev_ramp[2];
+static uint8_t rev_brake[2] = { 1, 1 };
+static volatile uint8_t rev_state[2];
+static volatile uint16_t rev_left[2];
+static uint16_t ramp_step[2];
+static uint16_t ramp_out[2];
+
+/*
+ * Staged output, while staging is set pwm() only records the pulses and
+ * commit() writes them to the preloaded compare registers back to back,
+ * away from an update event. The BSRR words of the channels are kept in
+ * pend_bsrr and written first thing by the update interrupt, so pins and
+ * pulses change at the same update, the pins a few cycles late. A channel
+ * in pend_skip lets one more update pass, it came before the pulses were
+ * written.
+ */
+#define COMMIT_CYCLES           32
+
+static uint8_t staging;
+static uint8_t staged;
+static uint16_t stage_pulse[2];
+static uint16_t commit_guard = COMMIT_CYCLES + 1;
+static volatile uint32_t pend_bsrr[2];
+static volatile uint8_t pend_skip;
+
+static void update_irq(void)
+{
+    if (pend_bsrr[MOTOR_A] || pend_bsrr[MOTOR_B] ||
+        kick_left[MOTOR_A] || kick_left[MOTOR_B] ||
+        rev_state[MOTOR_A] != REV_IDLE || rev_state[MOTOR_B] != REV_IDLE ||
+        motor_dir[MOTOR_A] == DIR_DYN_BRAKE || motor_dir[MOTOR_B] == DIR_DYN_BRAKE)
+    {
+        if ((TIM3->DIER & TIM_DIER_UIE) == 0)
+        {
+            TIM3->SR = ~TIM_SR_UIF;
+            TIM3->DIER |= TIM_DIER_UIE;
+        }
+    }
+    else
+        TIM3->DIER &= ~TIM_DIER_UIE;
+}
+
+static void pwm(uint8_t motor, uint16_t pulse)
+{
+    if (staging)
+    {
+        stage_pulse[motor] = pulse;
+        staged |= 1 << motor;
+    }
+    else if (motor == MOTOR_A)
+        pwm_a(pulse);
+    else
+        pwm_b(pulse);
+}
+
+/*
+ * BSRR pattern of STBY and the inputs of a channel for DIR_BRAKE .. DIR_STOP,
+ * the patterns of both channels can be or-ed into one write.
+ */
+static const uint32_t out_bsrr[2][4] = {
+    {
+        pin_hi(PIN_STBY) | pin_hi(PIN_AIN1) | pin_hi(PIN_AIN2),
+        pin_hi(PIN_STBY) | pin_lo(PIN_AIN1) | pin_hi(PIN_AIN2),
+        pin_hi(PIN_STBY) | pin_hi(PIN_AIN1) | pin_lo(PIN_AIN2),
+        pin_hi(PIN_STBY) | pin_lo(PIN_AIN1) | pin_lo(PIN_AIN2),
+    },
+    {
+        pin_hi(PIN_STBY) | pin_hi(PIN_BIN1) | pin_hi(PIN_BIN2),
+        pin_hi(PIN_STBY) | pin_lo(PIN_BIN1) | pin_hi(PIN_BIN2),
+        pin_hi(PIN_STBY) | pin_hi(PIN_BIN1) | pin_lo(PIN_BIN2),
+        pin_hi(PIN_STBY) | pin_lo(PIN_BIN1) | pin_lo(PIN_BIN2),
+    },
+};
+
+static void inputs(uint8_t motor, uint8_t dir)
+{
+    GPIOA->BSRR = out_bsrr[motor][dir];
+}
+
+/* bsrr 0 leaves the pins of that channel alone */
+static void commit(const uint32_t *bsrr)
+{
+    uint32_t old = 0;
+    uint8_t m, late;
+
+    staging = 0;
+    while (TIM3->CNT + commit_guard > TIM3->ARR)
+        ;
+    if (staged & (1 << MOTOR_A))
+        pwm_a(stage_pulse[MOTOR_A]);
+    if (staged & (1 << MOTOR_B))
+        pwm_b(stage_pulse[MOTOR_B]);
+    staged = 0;
+    late = (TIM3->DIER & TIM_DIER_UIE) && (TIM3->SR & TIM_SR_UIF);
+
+    for (m = MOTOR_A; m <= MOTOR_B; m++)
+    {
+        if (!bsrr[m])
+            continue;
+        if (late)
+        {
+            /* the pending update latched the pulses before these */
+            old |= pend_bsrr[m];
+            pend_skip |= 1 << m;
+        }
+        pend_bsrr[m] = bsrr[m];
+    }
+    if (old)
+        GPIOA->BSRR = old;
+    update_irq();
+}
+
+static void refresh(uint8_t motor)
+{
+    uint8_t dir = motor_dir[motor];
+
+    if (rev_state[motor] == REV_ZERO || rev_state[motor] == REV_HOLD)
+        return;
+    if (rev_state[motor] == REV_RAMP)
+        pwm(motor, shape(motor, ramp_out[motor]));
+    else if (dir == DIR_CW || dir == DIR_CCW)
+        pwm(motor, shape(motor, kick_left[motor] ? kick_pulse[motor] : motor_pulse[motor]));
+}
+
+/*
+ * Hold current reduction, after hold_delay ms without a new setpoint the
+ * channel output is scaled to hold_scale. The next command
+ * restores it before it is applied.
+ */
+static uint16_t hold_delay[2];
+static uint16_t hold_scale[2] = { SCALE_ONE, SCALE_ONE };
+static volatile uint16_t idle_ms[2];
+
+static void touch(uint8_t motor)
+{
+    idle_ms[motor] = 0;
+    if (scale_src[SCALE_HOLD][motor] != SCALE_ONE)
+        Set_TB6612_Scale(motor, SCALE_HOLD, SCALE_ONE);
+}
+
+static uint16_t drive_pulse(uint8_t motor, uint16_t pulse)
+{
+    uint8_t dir = motor_dir[motor];
+
+    touch(motor);
+    kick_left[motor] = 0;
+    motor_pulse[motor] = pulse;
+    if (kick_periods[motor] && pulse && pulse < kick_pulse[motor] &&
+        dir != DIR_CW && dir != DIR_CCW)
+    {
+        kick_left[motor] = kick_periods[motor];
+        update_irq();
+        pulse = kick_pulse[motor];
+    }
+    return shape(motor, pulse);
+}
+
+static uint32_t run(uint8_t motor, uint8_t dir, uint16_t pulse)
+{
+    uint8_t state = rev_state[motor];
+    uint8_t prev = motor_dir[motor];
+
+    if (state == REV_ZERO || state == REV_HOLD || (state == REV_RAMP && dir == prev))
+    {
+        /* sequence running, it picks up the new target */
+        touch(motor);
+        motor_pulse[motor] = pulse;
+        motor_dir[motor] = dir;
+        return pin_hi(PIN_STBY);
+    }
+    if (rev_periods[motor] && motor_pulse[motor] &&
+        (prev == DIR_CW || prev == DIR_CCW) && dir != prev)
+    {
+        touch(motor);
+        kick_left[motor] = 0;
+        pwm(motor, 0);
+        ramp_step[motor] = rev_ramp[motor] ? pulse / rev_ramp[motor] : pulse;
+        if (ramp_step[motor] == 0)
+            ramp_step[motor] = 1;
+        motor_pulse[motor] = pulse;
+        motor_dir[motor] = dir;
+        rev_state[motor] = REV_ZERO;
+        update_irq();
+        return pin_hi(PIN_STBY);
+    }
+    rev_state[motor] = REV_IDLE;
+    pwm(motor, drive_pulse(motor, pulse));
+    return out_bsrr[motor][dir];
+}
+
+/* called on each update while a reversal is running */
+static void reverse_tick(uint8_t motor)
+{
+    uint32_t out;
+
+    switch (rev_state[motor])
+    {
+        case REV_ZERO:
+            /* the zero pulse is latched now */
+            inputs(motor, rev_brake[motor] ? DIR_BRAKE : DIR_STOP);
+            rev_left[motor] = rev_periods[motor];
+            rev_state[motor] = REV_HOLD;
+        break;
+
+        case REV_HOLD:
+            if (rev_left[motor] && --rev_left[motor])
+                break;
+            inputs(motor, motor_dir[motor]);
+            ramp_out[motor] = 0;
+            rev_state[motor] = REV_RAMP;
+            /* fall through */
+
+        case REV_RAMP:
+            out = (uint32_t)ramp_out[motor] + ramp_step[motor];
+            if (out >= motor_pulse[motor])
+            {
+                out = motor_pulse[motor];
+                rev_state[motor] = REV_IDLE;
+            }
+            ramp_out[motor] = out;
+            pwm(motor, shape(motor, out));
+        break;
+    }
+}
+
+/*
+ * Proportional brake, the inputs of the channel are switched to short brake
+ * at the start of each PWM period and back to coast at its compare match,
+ * so the pulse sets the braking part of the period. The IN pins are plain
+ * GPIO on this board, the switching is done by the TIM3 update and compare
+ * interrupts, which are only enabled while a brake is running. Two
+ * interrupts per period would starve the CPU at high PWM frequencies, so
+ * above DYN_BRAKE_MAX_FREQ the brake is a plain short brake instead.
+ */
+static const uint32_t brake_pins[2] = {
+    (1u << PIN_AIN1) | (1u << PIN_AIN2),
+    (1u << PIN_BIN1) | (1u << PIN_BIN2),
+};
+static const uint16_t brake_irq[2] = { TIM_DIER_CC1IE, TIM_DIER_CC2IE };
+
+static void brake_off(uint8_t motor)
+{
+    TIM3->DIER &= ~brake_irq[motor];
+    if (motor_dir[motor] == DIR_DYN_BRAKE)
+        motor_dir[motor] = DIR_STOP;
+}
+
+static void brake_on(uint8_t motor, uint16_t pulse)
+{
+    pwm(motor, pulse);
+    motor_dir[motor] = DIR_DYN_BRAKE;
+    TIM3->SR = ~brake_irq[motor];
+    TIM3->DIER |= brake_irq[motor];
+    update_irq();
+}
+
+static void standby(void)
+{
+    brake_off(MOTOR_A);
+    brake_off(MOTOR_B);
+    rev_state[MOTOR_A] = REV_IDLE;
+    rev_state[MOTOR_B] = REV_IDLE;
+    kick_left[MOTOR_A] = 0;
+    kick_left[MOTOR_B] = 0;
+    pend_bsrr[MOTOR_A] = 0;
+    pend_bsrr[MOTOR_B] = 0;
+    pend_skip = 0;
+    pin_clear(PIN_STBY);
+    pwm_a(0);
+    pwm_b(0);
+    motor_dir[MOTOR_A] = DIR_STANDBY;
+    motor_dir[MOTOR_B] = DIR_STANDBY;
+    motor_pulse[MOTOR_A] = 0;
+    motor_pulse[MOTOR_B] = 0;
+}
+
+static uint32_t pwm_freq = 1000;
+
 void Set_Freq(uint32_t freq)
 {
+    uint8_t m;
+
     if (freq > 80000)
         freq = 80000;
     else if (freq < 1)
         freq = 1;
+    pwm_freq = freq;
     if (freq < 20)
         TIM3->PSC = 125 - 1;
     else if (freq < 1000)
@@ -19,81 +401,296 @@ void Set_Freq(uint32_t freq)
     else
         TIM3->PSC = 0;
     TIM3->ARR = 8000000 / (TIM3->PSC + 1) / freq;
+    commit_guard = COMMIT_CYCLES / (TIM3->PSC + 1) + 1;
+    TIM3->CCR4 = TIM3->ARR >> 1;    /* ADC trigger, see adc.c */
+
+    if (freq <= DYN_BRAKE_MAX_FREQ)
+        return;
+    __disable_irq();
+    for (m = MOTOR_A; m <= MOTOR_B; m++)
+    {
+        if (motor_dir[m] != DIR_DYN_BRAKE)
+            continue;
+        brake_off(m);
+        pwm(m, 0);
+        inputs(m, DIR_BRAKE);
+        motor_dir[m] = DIR_BRAKE;
+    }
+    update_irq();
+    __enable_irq();
 }
 
-void Set_TB6612_Dir(uint8_t motor, uint8_t dir, uint16_t pulse)
+static uint32_t channel(uint8_t motor, uint8_t dir, uint16_t pulse)
 {
-    switch (dir)
+    uint32_t bsrr;
+
+    brake_off(motor);
+    if (dir == DIR_DYN_BRAKE && pwm_freq > DYN_BRAKE_MAX_FREQ)
+        dir = DIR_BRAKE;
+    if (dir != DIR_CW && dir != DIR_CCW)
     {
-        case DIR_BRAKE:
-            pin_set(PIN_STBY);
-            if (motor == MOTOR_A)
-            {
-                pin_set(PIN_AIN1);
-                pin_set(PIN_AIN2);
-                pwm_a(0);
-            }
-            else
-            {
-                pin_set(PIN_BIN1);
-                pin_set(PIN_BIN2);
-                pwm_b(0);
-            }
-        break;
+        rev_state[motor] = REV_IDLE;
+        kick_left[motor] = 0;
+    }
 
+    switch (dir)
+    {
         case DIR_CCW:
-            pin_set(PIN_STBY);
-            if (motor == MOTOR_A)
-            {
-                pin_clear(PIN_AIN1);
-                pin_set(PIN_AIN2);
-                pwm_a(pulse);
-            }
-            else
-            {
-                pin_clear(PIN_BIN1);
-                pin_set(PIN_BIN2);
-                pwm_b(pulse);
-            }
-        break;
-
         case DIR_CW:
-            pin_set(PIN_STBY);
-            if (motor == MOTOR_A)
-            {
-                pin_set(PIN_AIN1);
-                pin_clear(PIN_AIN2);
-                pwm_a(pulse);
-            }
-            else
-            {
-                pin_set(PIN_BIN1);
-                pin_clear(PIN_BIN2);
-                pwm_b(pulse);
-            }
+            bsrr = run(motor, dir, pulse);
         break;
 
-        case DIR_STOP:
-            pin_set(PIN_STBY);
-            if (motor == MOTOR_A)
-            {
-                pin_clear(PIN_AIN1);
-                pin_clear(PIN_AIN2);
-                pwm_a(0);
-            }
-            else
-            {
-                pin_clear(PIN_BIN1);
-                pin_clear(PIN_BIN2);
-                pwm_b(0);
-            }
+        case DIR_DYN_BRAKE:
+            brake_on(motor, pulse);
+            bsrr = pin_hi(PIN_STBY);
         break;
 
-        case DIR_STANDBY:
-            pin_clear(PIN_STBY);
-            pwm_a(0);
-            pwm_b(0);
+        default:
+            pwm(motor, 0);
+            bsrr = out_bsrr[motor][dir];
         break;
     }
+
+    motor_dir[motor] = dir;
+    motor_pulse[motor] = (dir == DIR_CW || dir == DIR_CCW) ? pulse : 0;
+    return bsrr;
+}
+
+/*
+ * motor may be MOTOR_AB. The new pulses and the pins of all channels take
+ * effect together at the next update event, the pins in one BSRR write
+ * (see commit()); standby is immediate.
+ */
+void Set_TB6612_Dir(uint8_t motor, uint8_t dir, uint16_t pulse)
+{
+    uint32_t primask;
+
+    if (dir > DIR_DYN_BRAKE)
+        return;
+
+    if (dir == DIR_STANDBY)
+    {
+        primask = __get_PRIMASK();
+        __disable_irq();
+        standby();
+        __set_PRIMASK(primask);
+    }
+    else
+        Set_TB6612_Drive(motor != MOTOR_B ? dir : DIR_KEEP, pulse,
+                         motor != MOTOR_A ? dir : DIR_KEEP, pulse);
+}
+
+/*
+ * Both channels in one commit, DIR_KEEP leaves a channel as it is. Both
+ * pulses are worked out first, so they and the pins change in the same
+ * PWM period. Interrupts are off from the inhibit check on, an
+ * undervoltage standby from the ADC interrupt cannot be overwritten half
+ * way.
+ */
+void Set_TB6612_Drive(uint8_t dir_a, uint16_t pulse_a, uint8_t dir_b, uint16_t pulse_b)
+{
+    uint32_t primask, bsrr[2] = { 0, 0 };
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    if (!inhibit)
+    {
+        staging = 1;
+        if (dir_a <= DIR_DYN_BRAKE && dir_a != DIR_STANDBY)
+            bsrr[MOTOR_A] = channel(MOTOR_A, dir_a, pulse_a);
+        if (dir_b <= DIR_DYN_BRAKE && dir_b != DIR_STANDBY)
+            bsrr[MOTOR_B] = channel(MOTOR_B, dir_b, pulse_b);
+        commit(bsrr);
+    }
+    __set_PRIMASK(primask);
+}
+
+uint32_t Get_Freq(void)
+{
+    return pwm_freq;
+}
+
+uint8_t Get_TB6612_Dir(uint8_t motor)
+{
+    return motor_dir[motor];
+}
+
+uint16_t Get_TB6612_Pulse(uint8_t motor)
+{
+    return motor_pulse[motor];
+}
+
+void Set_TB6612_Lut(uint8_t motor, uint8_t point, uint16_t value)
+{
+    if (point < LUT_POINTS)
+        lut[motor][point] = value > LUT_FULL ? LUT_FULL : value;
+}
+
+uint16_t Get_TB6612_Lut(uint8_t motor, uint8_t point)
+{
+    return point < LUT_POINTS ? lut[motor][point] : 0;
+}
+
+void Enable_TB6612_Lut(uint8_t motor, uint8_t on)
+{
+    lut_on[motor] = on;
 }
 
+uint8_t Get_TB6612_Lut_Enabled(uint8_t motor)
+{
+    return lut_on[motor];
+}
+
+void Set_TB6612_Kick(uint8_t motor, uint16_t pulse, uint16_t periods)
+{
+    kick_pulse[motor] = pulse;
+    kick_periods[motor] = periods;
+}
+
+uint16_t Get_TB6612_Kick_Pulse(uint8_t motor)
+{
+    return kick_pulse[motor];
+}
+
+uint16_t Get_TB6612_Kick_Periods(uint8_t motor)
+{
+    return kick_periods[motor];
+}
+
+void Set_TB6612_Reverse(uint8_t motor, uint16_t periods, uint16_t ramp, uint8_t brake)
+{
+    rev_periods[motor] = periods;
+    rev_ramp[motor] = ramp;
+    rev_brake[motor] = brake ? 1 : 0;
+}
+
+uint16_t Get_TB6612_Reverse_Periods(uint8_t motor)
+{
+    return rev_periods[motor];
+}
+
+uint16_t Get_TB6612_Reverse_Ramp(uint8_t motor)
+{
+    return rev_ramp[motor];
+}
+
+uint8_t Get_TB6612_Reverse_Brake(uint8_t motor)
+{
+    return rev_brake[motor];
+}
+
+/* while inhibited the bridges stay in standby and commands are dropped */
+void Set_TB6612_Inhibit(uint8_t on)
+{
+    inhibit = on;
+    if (on)
+        standby();
+}
+
+uint8_t Get_TB6612_Inhibit(void)
+{
+    return inhibit;
+}
+
+void Set_TB6612_Scale(uint8_t motor, uint8_t src, uint16_t scale)
+{
+    uint32_t s;
+    uint8_t m, i;
+
+    for (m = MOTOR_A; m <= MOTOR_B; m++)
+    {
+        if (motor != MOTOR_AB && motor != m)
+            continue;
+        if (scale_src[src][m] == scale)
+            continue;
+
+        scale_src[src][m] = scale;
+        s = SCALE_ONE;
+        for (i = 0; i < SCALE_SOURCES; i++)
+            s = (s * scale_src[i][m]) >> 12;
+        out_scale[m] = s > SCALE_MAX ? SCALE_MAX : s;
+        refresh(m);
+    }
+}
+
+void Set_TB6612_Limit(uint16_t limit)
+{
+    if (limit == out_limit)
+        return;
+
+    out_limit = limit > SCALE_ONE ? SCALE_ONE : limit;
+    refresh(MOTOR_A);
+    refresh(MOTOR_B);
+}
+
+void Set_TB6612_Hold(uint8_t motor, uint16_t delay, uint16_t scale)
+{
+    hold_delay[motor] = delay;
+    hold_scale[motor] = scale > SCALE_ONE ? SCALE_ONE : scale;
+    touch(motor);
+}
+
+uint16_t Get_TB6612_Hold_Delay(uint8_t motor)
+{
+    return hold_delay[motor];
+}
+
+uint16_t Get_TB6612_Hold_Scale(uint8_t motor)
+{
+    return hold_scale[motor];
+}
+
+void TB6612_Tick(void)
+{
+    uint8_t motor;
+
+    for (motor = MOTOR_A; motor <= MOTOR_B; motor++)
+        if (hold_delay[motor] && idle_ms[motor] < hold_delay[motor] &&
+            ++idle_ms[motor] == hold_delay[motor])
+            Set_TB6612_Scale(motor, SCALE_HOLD, hold_scale[motor]);
+}
+
+void TIM3_IRQHandler(void)
+{
+    uint32_t sr = TIM3->SR & TIM3->DIER;
+    uint32_t set = 0;
+    uint8_t motor, skip;
+
+    TIM3->SR = ~sr;
+
+    if (sr & TIM_SR_UIF)
+    {
+        skip = pend_skip;
+        pend_skip = 0;
+        for (motor = MOTOR_A; motor <= MOTOR_B; motor++)
+        {
+            if (skip & (1 << motor))
+                continue;
+            set |= pend_bsrr[motor];
+            pend_bsrr[motor] = 0;
+        }
+        if (set)
+            GPIOA->BSRR = set;
+        set = 0;
+
+        for (motor = MOTOR_A; motor <= MOTOR_B; motor++)
+        {
+            if (skip & (1 << motor))
+                continue;
+            if (kick_left[motor] && --kick_left[motor] == 0)
+                pwm(motor, shape(motor, motor_pulse[motor]));
+            if (rev_state[motor] != REV_IDLE)
+                reverse_tick(motor);
+            if (motor_dir[motor] == DIR_DYN_BRAKE)
+                set |= brake_pins[motor];
+        }
+        if (set)
+            GPIOA->BSRR = set;
+    }
+    if (sr & TIM_SR_CC1IF)
+        GPIOA->BRR = brake_pins[MOTOR_A];
+    if (sr & TIM_SR_CC2IF)
+        GPIOA->BRR = brake_pins[MOTOR_B];
+
+    update_irq();
+}
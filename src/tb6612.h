@@ -15,6 +15,16 @@
 #define PIN_SWD                 13
 #define PIN_SWC                 14
 
+/* spare pins, PA5 and PB1 */
+#define PIN_SPARE1              5
+#define PIN_SPARE2              1
+
+#define MODE_IN                 0x00
+#define MODE_OUT                0x01
+#define MODE_AF                 0x02
+#define MODE_AN                 0x03
+#define MODER(mode, pin)        ((mode) << (2 * (pin)))
+
 #define MOTOR_A                 0
 #define MOTOR_B                 1
 #define MOTOR_AB                2
@@ -24,9 +34,45 @@
 #define DIR_CW                  0x02
 #define DIR_STOP                0x03
 #define DIR_STANDBY             0x04
+#define DIR_DYN_BRAKE           0x05    /* pulse = braking part of the period */
+#define DIR_KEEP                0xff    /* Set_TB6612_Drive(), channel left alone */
+
+#define DYN_BRAKE_MAX_FREQ      10000   /* Hz, above it DIR_DYN_BRAKE brakes fully */
+
+#define LUT_POINTS              17
+
+#define SCALE_ONE               (1u << 12)
+#define SCALE_MAX               (2u << 12)
+#define SCALE_VSUPPLY           0
+#define SCALE_HOLD              1
+#define SCALE_FAILSAFE          2
+#define SCALE_SOURCES           3
 
 extern void Set_Freq(uint32_t freq);
+extern uint32_t Get_Freq(void);
 extern void Set_TB6612_Dir(uint8_t motor, uint8_t dir, uint16_t pulse);
+extern void Set_TB6612_Drive(uint8_t dir_a, uint16_t pulse_a, uint8_t dir_b, uint16_t pulse_b);
+extern uint8_t Get_TB6612_Dir(uint8_t motor);
+extern uint16_t Get_TB6612_Pulse(uint8_t motor);
+extern void Set_TB6612_Lut(uint8_t motor, uint8_t point, uint16_t value);
+extern uint16_t Get_TB6612_Lut(uint8_t motor, uint8_t point);
+extern void Enable_TB6612_Lut(uint8_t motor, uint8_t on);
+extern uint8_t Get_TB6612_Lut_Enabled(uint8_t motor);
+extern void Set_TB6612_Kick(uint8_t motor, uint16_t pulse, uint16_t periods);
+extern uint16_t Get_TB6612_Kick_Pulse(uint8_t motor);
+extern uint16_t Get_TB6612_Kick_Periods(uint8_t motor);
+extern void Set_TB6612_Reverse(uint8_t motor, uint16_t periods, uint16_t ramp, uint8_t brake);
+extern uint16_t Get_TB6612_Reverse_Periods(uint8_t motor);
+extern uint16_t Get_TB6612_Reverse_Ramp(uint8_t motor);
+extern uint8_t Get_TB6612_Reverse_Brake(uint8_t motor);
+extern void Set_TB6612_Scale(uint8_t motor, uint8_t src, uint16_t scale);
+extern void Set_TB6612_Limit(uint16_t limit);
+extern void Set_TB6612_Inhibit(uint8_t on);
+extern uint8_t Get_TB6612_Inhibit(void);
+extern void Set_TB6612_Hold(uint8_t motor, uint16_t delay, uint16_t scale);
+extern uint16_t Get_TB6612_Hold_Delay(uint8_t motor);
+extern uint16_t Get_TB6612_Hold_Scale(uint8_t motor);
+extern void TB6612_Tick(void);
 
 #endif
 
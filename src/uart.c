@@ -0,0 +1,100 @@
+#include "stm32f030x6.h"
+#include "uart.h"
+#include "tb6612.h"
+#include "sched.h"
+
+/*
+ * USART1 on PA9 (TX) and PA10 (RX), AF1, instead of I2C1 on the same pins.
+ *
+ * DMA channel 3 receives into a circular ring that the main loop drains
+ * with Uart_Read(), nothing runs per byte. The half and full ring DMA
+ * interrupts and the USART idle line interrupt post the event given to
+ * Uart_Init(), so a packet is handled as soon as the line goes quiet and
+ * a long stream every half ring. A ring overrun loses data, the framing
+ * on top notices it.
+ *
+ * Uart_Write() copies the data and sends it with DMA channel 2, waiting
+ * for a transfer still running first.
+ *
+ * 8 N 1, oversampling by 8 so the 8 MHz HSI reaches 1 Mbaud.
+ */
+
+#define UART_DIV                (2 * 8000000 / UART_BAUD)
+
+static uint8_t rx_ring[UART_RX_RING];
+static uint8_t rx_tail;
+static uint8_t tx_buf[UART_TX_MAX];
+static uint8_t uart_event;
+
+void USART1_IRQHandler(void)
+{
+    if (USART1->ISR & USART_ISR_IDLE)
+    {
+        USART1->ICR = USART_ICR_IDLECF;
+        Sched_Post(uart_event);
+    }
+    USART1->ICR = USART_ICR_ORECF | USART_ICR_FECF | USART_ICR_NCF;
+}
+
+void DMA1_Channel2_3_IRQHandler(void)
+{
+    if (DMA1->ISR & (DMA_ISR_HTIF3 | DMA_ISR_TCIF3))
+        Sched_Post(uart_event);
+    DMA1->IFCR = DMA_IFCR_CGIF3;
+}
+
+void Uart_Init(uint8_t event)
+{
+    uart_event = event;
+
+    RCC->AHBENR |= RCC_AHBENR_DMA1EN;
+    RCC->APB2ENR |= RCC_APB2ENR_USART1EN;
+
+    GPIOA->MODER |= MODER(MODE_AF, PIN_SCL) | MODER(MODE_AF, PIN_SDA);
+    GPIOA->AFR[1] |= (1 << GPIO_AFRH_AFRH1_Pos) | (1 << GPIO_AFRH_AFRH2_Pos);
+    GPIOA->PUPDR |= GPIO_PUPDR_PUPDR10_0;
+
+    DMA1_Channel3->CPAR = (uint32_t)&USART1->RDR;
+    DMA1_Channel3->CMAR = (uint32_t)rx_ring;
+    DMA1_Channel3->CNDTR = UART_RX_RING;
+    DMA1_Channel3->CCR = DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_HTIE |
+        DMA_CCR_TCIE | DMA_CCR_EN;
+
+    DMA1_Channel2->CPAR = (uint32_t)&USART1->TDR;
+    DMA1_Channel2->CMAR = (uint32_t)tx_buf;
+
+    USART1->BRR = (UART_DIV & ~0x0f) | ((UART_DIV & 0x0f) >> 1);
+    USART1->CR3 = USART_CR3_DMAR | USART_CR3_DMAT | USART_CR3_OVRDIS;
+    USART1->CR1 = USART_CR1_OVER8 | USART_CR1_IDLEIE | USART_CR1_TE |
+        USART_CR1_RE | USART_CR1_UE;
+
+    NVIC_EnableIRQ(DMA1_Channel2_3_IRQn);
+    NVIC_EnableIRQ(USART1_IRQn);
+}
+
+uint8_t Uart_Read(uint8_t *b)
+{
+    uint8_t head = (UART_RX_RING - DMA1_Channel3->CNDTR) & (UART_RX_RING - 1);
+
+    if (rx_tail == head)
+        return 0;
+    *b = rx_ring[rx_tail];
+    rx_tail = (rx_tail + 1) & (UART_RX_RING - 1);
+    return 1;
+}
+
+void Uart_Write(const uint8_t *data, uint8_t len)
+{
+    uint8_t i;
+
+    if (len > UART_TX_MAX)
+        len = UART_TX_MAX;
+    while (DMA1_Channel2->CNDTR)
+        ;
+    DMA1_Channel2->CCR = 0;
+    for (i = 0; i < len; i++)
+        tx_buf[i] = data[i];
+    DMA1->IFCR = DMA_IFCR_CGIF2;
+    DMA1_Channel2->CNDTR = len;
+    DMA1_Channel2->CCR = DMA_CCR_MINC | DMA_CCR_DIR | DMA_CCR_EN;
+}
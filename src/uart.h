@@ -0,0 +1,14 @@
+#ifndef __UART_H
+#define __UART_H
+
+#include <stdint.h>
+
+#define UART_BAUD               1000000
+#define UART_RX_RING            64      /* power of two */
+#define UART_TX_MAX             32
+
+extern void Uart_Init(uint8_t event);
+extern uint8_t Uart_Read(uint8_t *b);
+extern void Uart_Write(const uint8_t *data, uint8_t len);
+
+#endif
@@ -1,6 +1,12 @@
 #include "stm32f030x6.h"
 #include "user_i2c.h"
 #include "tb6612.h"
+#include "param.h"
+#include "gear.h"
+#include "drive.h"
+#include "failsafe.h"
+#include "config.h"
+#include "boot.h"
 
 /*
 total 4bytes
@@ -11,12 +17,41 @@ CMD								| 	parm
 0x0X  set freq  	|  uint32  freq
 0x10  set motorA  |  uint8 dir  uint16 pwm
 0x11  set motorB  |  uint8 dir  uint16 pwm
+0x12  set both    |  uint8 dir  uint16 pwm     (switched together)
+0x2m  set param   |  uint8 id   uint16 value   (m = motor, see param.h)
+0x30  drive       |  int12 v    int12 w        (fractions of 2047)
+0x5m  get param   |  uint8 id                  (m = motor, see param.h)
+0x60  keepalive   |
+0x70  save config |                            (params and freq to flash)
+0x71  erase config|                            (defaults at next reset)
+0xf0  bootloader  |  'B' 'O' 'T'               (reset into the bootloader)
+
+dir is one of the DIR_ values in tb6612.h. With DIR_DYN_BRAKE the pwm
+value is the braking part of the PWM period, the rest of it coasts; above
+10 kHz (DYN_BRAKE_MAX_FREQ) it is a full brake.
+
+A read after get param returns the value as int32, most significant
+byte first.
+
+While gearing is enabled motor B is driven by the follower loop and
+ignores set motorB, set both and the right wheel of drive.
+
+Save and erase config take up to 40 ms with the CPU stalled, stop the
+motors first. A read after them returns 0, or -1 on a flash error.
+
+Every command but get param feeds the failsafe, see failsafe.c. The
+keepalive does nothing else.
 */
 
+uint8_t i2c_reply[4];
+
 void user_i2c_proc(uint8_t i2c_data[4])
 {
     uint8_t cmd = (i2c_data[0] >> 4);
 
+    if (cmd <= 7 && cmd != 5)
+        Failsafe_Feed();
+
     switch(cmd)
     {
         case 0:
@@ -30,13 +65,64 @@ void user_i2c_proc(uint8_t i2c_data[4])
         }
         case 1:
         {
-            uint8_t motor = i2c_data[0] & 0x01;
+            uint8_t motor = i2c_data[0] & 0x03;
             uint8_t dir = i2c_data[1];
             uint16_t pulse = (uint16_t)i2c_data[2] << 8 | (uint16_t)i2c_data[3];
 
+            if (motor > MOTOR_AB || (motor != MOTOR_A && Gear_Enabled()))
+                break;
             Set_TB6612_Dir(motor, dir, pulse);
             break;
         }
+        case 2:
+        {
+            uint8_t motor = i2c_data[0] & 0x01;
+            uint8_t id = i2c_data[1];
+            uint16_t value = (uint16_t)i2c_data[2] << 8 | (uint16_t)i2c_data[3];
+
+            Set_Param(motor, id, value);
+            break;
+        }
+        case 3:
+        {
+            int16_t v = (int16_t)((uint16_t)i2c_data[1] << 8 | (i2c_data[2] & 0xf0)) >> 4;
+            int16_t w = (int16_t)((uint16_t)i2c_data[2] << 12 | (uint16_t)i2c_data[3] << 4) >> 4;
+
+            Drive_Set_Velocity(v, w);
+            break;
+        }
+        case 5:
+        {
+            int32_t value = Get_Param(i2c_data[0] & 0x01, i2c_data[1]);
+
+            i2c_reply[0] = value >> 24;
+            i2c_reply[1] = value >> 16;
+            i2c_reply[2] = value >> 8;
+            i2c_reply[3] = value;
+            break;
+        }
+        case 6:
+            break;
+        case 7:
+        {
+            int32_t rc = -1;
+
+            if ((i2c_data[0] & 0x0f) == 0)
+                rc = Config_Save();
+            else if ((i2c_data[0] & 0x0f) == 1)
+                rc = Config_Erase();
+
+            i2c_reply[0] = rc >> 24;
+            i2c_reply[1] = rc >> 16;
+            i2c_reply[2] = rc >> 8;
+            i2c_reply[3] = rc;
+            break;
+        }
+        case 15:
+            if (i2c_data[0] == 0xf0 && i2c_data[1] == 'B' && i2c_data[2] == 'O' &&
+                i2c_data[3] == 'T')
+                Boot_Enter();
+            break;
     }
 }
 
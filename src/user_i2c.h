@@ -3,6 +3,8 @@
 
 #include <stdint.h>
 
+extern uint8_t i2c_reply[4];
+
 void user_i2c_proc(uint8_t i2c_data[4]);
 
 #endif
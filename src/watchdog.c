@@ -0,0 +1,108 @@
+#include "stm32f030x6.h"
+#include "watchdog.h"
+
+/*
+ * Independent watchdog.
+ *
+ * The IWDG runs from the ~40 kHz LSI divided by 4. It is fed from the
+ * 1 ms SysTick every WDG_FEED_MS ms, but only once every source has
+ * checked in since the last feed, so a stuck main loop or a dead SysTick
+ * resets the MCU after WDG_TIMEOUT_MS. Feeds earlier than WDG_EARLY_MS
+ * after the last one are outside the window and reset it as well.
+ *
+ * Watchdog_Stretch() reloads it with the longest timeout and no window
+ * around flash erases, which stall the CPU for up to 40 ms.
+ *
+ * The reset cause is the RCC_CSR flag byte captured at boot, resets
+ * since power on are counted in RAM the startup code does not clear.
+ */
+
+#define WDG_TICKS_PER_MS        10
+#define WDG_FEED_MS             8
+#define WDG_TIMEOUT_MS          20
+#define WDG_EARLY_MS            2
+#define WDG_RELOAD              (WDG_TIMEOUT_MS * WDG_TICKS_PER_MS)
+#define WDG_WINDOW              (WDG_RELOAD - WDG_EARLY_MS * WDG_TICKS_PER_MS)
+#define WDG_MAGIC               0x57444721
+
+static uint32_t wdg_magic __attribute__((section(".noinit")));
+static uint32_t wdg_resets __attribute__((section(".noinit")));
+static uint8_t reset_cause;
+static volatile uint8_t wdg_seen[WDG_SOURCES];
+static uint8_t wdg_ms;
+
+/* a feed from SysTick in between would write protect the registers again */
+static void reload(uint16_t rlr, uint16_t winr)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    IWDG->KR = 0x5555;
+    IWDG->RLR = rlr;
+    while (IWDG->SR);
+    IWDG->WINR = winr;      /* also reloads the counter */
+    __set_PRIMASK(primask);
+}
+
+void Watchdog_Init(void)
+{
+    uint32_t csr = RCC->CSR;
+
+    RCC->CSR |= RCC_CSR_RMVF;
+    reset_cause = csr >> 24;
+    if ((csr & RCC_CSR_PORRSTF) || wdg_magic != WDG_MAGIC)
+    {
+        wdg_magic = WDG_MAGIC;
+        wdg_resets = 0;
+    }
+    else
+        wdg_resets++;
+
+    IWDG->KR = 0xcccc;
+    IWDG->KR = 0x5555;
+    IWDG->PR = 0;
+    reload(WDG_RELOAD, WDG_WINDOW);
+}
+
+void Watchdog_Stretch(uint8_t on)
+{
+    if (on)
+    {
+        reload(IWDG_RLR_RL, IWDG_WINR_WIN);
+        return;
+    }
+
+    reload(WDG_RELOAD, WDG_WINDOW);
+    wdg_ms = 0;
+}
+
+void Watchdog_Checkin(uint8_t src)
+{
+    wdg_seen[src] = 1;
+}
+
+void Watchdog_Tick(void)
+{
+    uint8_t i;
+
+    if (wdg_ms < WDG_FEED_MS && ++wdg_ms < WDG_FEED_MS)
+        return;
+    for (i = 0; i < WDG_SOURCES; i++)
+        if (!wdg_seen[i])
+            return;
+
+    for (i = 0; i < WDG_SOURCES; i++)
+        wdg_seen[i] = 0;
+    wdg_ms = 0;
+    IWDG->KR = 0xaaaa;
+}
+
+uint8_t Get_Reset_Cause(void)
+{
+    return reset_cause;
+}
+
+uint32_t Get_Reset_Count(void)
+{
+    return wdg_resets;
+}
@@ -0,0 +1,17 @@
+#ifndef __WATCHDOG_H
+#define __WATCHDOG_H
+
+#include <stdint.h>
+
+/* check-in sources, all of them have to check in for a feed */
+#define WDG_MAIN                0
+#define WDG_SOURCES             1
+
+extern void Watchdog_Init(void);
+extern void Watchdog_Checkin(uint8_t src);
+extern void Watchdog_Tick(void);
+extern void Watchdog_Stretch(uint8_t on);
+extern uint8_t Get_Reset_Cause(void);
+extern uint32_t Get_Reset_Count(void);
+
+#endif
@@ -0,0 +1,147 @@
+/*
+ * Gives every shield on a bus its own I2C address from its unique ID, see
+ * the address assignment in src/main.c.
+ *
+ *   i2c_assign [-b bus] [-a first] [-r]
+ *       reads the lowest ID of the shields still without an address on
+ *       the address resolution address and assigns it the next free address
+ *       from first (default 0x30) on, until all have one; -r drops all
+ *       assignments first, so the whole bus is numbered again
+ *
+ * Addresses something else on the bus answers on are skipped. The shields
+ * save their address with the rest of their configuration and keep it
+ * over resets, the bootloader uses it as well.
+ */
+
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linux/i2c-dev.h>
+
+#include "config.h"
+#include "frame.h"
+
+#define ARP_ASSIGN              0x01
+#define ARP_RESET               0x02
+#define ARP_UID                 12
+#define SAVE_WAIT_US            100000  /* config save on the shield */
+
+static int bus = -1;
+
+static int target(int addr)
+{
+    return ioctl(bus, I2C_SLAVE, addr);
+}
+
+/* something acks a read at addr */
+static int present(int addr)
+{
+    uint8_t b;
+
+    return target(addr) == 0 && read(bus, &b, 1) == 1;
+}
+
+/* 1 with the winning ID, 0 when all shields have an address */
+static int read_uid(uint8_t *uid)
+{
+    uint8_t rx[ARP_UID + 1], crc = 0;
+    int i, all = 0xff;
+
+    if (target(I2C_ARP_ADDR) || read(bus, rx, sizeof(rx)) != sizeof(rx))
+        return 0;
+    for (i = 0; i < ARP_UID; i++)
+    {
+        crc = Frame_Crc(crc, rx[i]);
+        all &= rx[i];
+    }
+    if (all == 0xff)
+        return 0;
+    if (crc != rx[ARP_UID])
+        return -1;
+    memcpy(uid, rx, ARP_UID);
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    int bus_nr = 1, addr = 0x30, reset = 0, opt, rc, tries = 0, n = 0;
+    uint8_t uid[ARP_UID], tx[1 + ARP_UID + 1];
+    char path[32];
+    int i;
+
+    while ((opt = getopt(argc, argv, "b:a:r")) != -1)
+    {
+        switch (opt)
+        {
+            case 'b': bus_nr = atoi(optarg); break;
+            case 'a': addr = strtol(optarg, NULL, 0); break;
+            case 'r': reset = 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-b bus] [-a first] [-r]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    snprintf(path, sizeof(path), "/dev/i2c-%d", bus_nr);
+    bus = open(path, O_RDWR);
+    if (bus < 0 || target(I2C_ARP_ADDR) < 0)
+    {
+        perror(path);
+        return 1;
+    }
+
+    if (reset)
+    {
+        tx[0] = ARP_RESET;
+        if (write(bus, tx, 1) != 1)
+            perror("reset");
+        usleep(SAVE_WAIT_US);
+    }
+
+    while ((rc = read_uid(uid)) != 0)
+    {
+        if (rc < 0)
+        {
+            if (++tries == 3)
+            {
+                fprintf(stderr, "unique ID read keeps failing its CRC\n");
+                return 1;
+            }
+            continue;
+        }
+        tries = 0;
+
+        while (addr <= 0x77 && (!I2C_ADDR_VALID(addr) || present(addr)))
+            addr++;
+        if (addr > 0x77)
+        {
+            fprintf(stderr, "no free address left\n");
+            return 1;
+        }
+
+        tx[0] = ARP_ASSIGN;
+        memcpy(tx + 1, uid, ARP_UID);
+        tx[1 + ARP_UID] = addr;
+        if (target(I2C_ARP_ADDR) || write(bus, tx, sizeof(tx)) != sizeof(tx))
+        {
+            perror("assign");
+            return 1;
+        }
+        usleep(SAVE_WAIT_US);
+
+        for (i = 0; i < ARP_UID; i++)
+            printf("%02x", uid[ARP_UID - 1 - i]);
+        printf(" -> 0x%02x\n", addr);
+        addr++;
+        n++;
+    }
+
+    printf("%d shield%s assigned\n", n, n == 1 ? "" : "s");
+    close(bus);
+    return 0;
+}
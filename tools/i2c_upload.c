@@ -0,0 +1,411 @@
+/*
+ * Host side of the I2C bootloader, see src/boot.h and boot/proto.c.
+ *
+ *   i2c_upload -m motor_shield.bin motor_shield.img
+ *       pad an application binary to APP_SIZE and append its CRC
+ *
+ *   i2c_upload [-b bus] [-a addr] [-u] motor_shield.img
+ *       reset the shield into the bootloader over /dev/i2c-<bus>, write
+ *       the pages whose CRC differs and start the new image
+ *
+ *   i2c_upload -s target.bin [-x pages] motor_shield.img
+ *       the same against a simulated target, which runs boot/proto.c on
+ *       target.bin as its flash; -x stops after that many page writes to
+ *       try resuming an interrupted transfer
+ *
+ * Pages already matching are skipped, so running it again after an
+ * interruption only sends what is left. A bootloader from version 2 on
+ * takes pages LZSS compressed, which is used whenever it makes the page
+ * shorter, -u sends them as they are. The compression ratio and the
+ * throughput are reported at the end, for the simulated target as the
+ * time the same traffic takes at 100 kHz.
+ */
+
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <linux/i2c-dev.h>
+
+#include "boot.h"
+#include "proto.h"
+
+#define SIM_BUS_HZ              100000
+#define SIM_PAGE_US             22000   /* page erase and program */
+#define WRITE_WAIT_US           45000
+#define RETRIES                 3
+
+static uint8_t image[APP_SIZE];
+
+static int bus = -1;
+static const char *sim_file;
+static uint32_t sim_flash[APP_SIZE / 4];
+static int sim_pages_left = -1;
+static int sim_run;
+
+static int zload;
+static unsigned long page_bytes, sent_bytes;
+
+static unsigned long bus_bytes;
+static unsigned long sim_us;
+
+/* CRC unit of the STM32F0 with its reset configuration */
+uint32_t boot_crc(const uint32_t *data, uint32_t words)
+{
+    uint32_t crc = 0xffffffff;
+    int i;
+
+    while (words--)
+    {
+        crc ^= *data++;
+        for (i = 0; i < 32; i++)
+            crc = crc & 0x80000000 ? (crc << 1) ^ 0x04c11db7 : crc << 1;
+    }
+    return crc;
+}
+
+int boot_flash_page(uint8_t page, const uint32_t *data)
+{
+    if (sim_pages_left == 0)
+    {
+        fprintf(stderr, "simulated target: interrupted\n");
+        return -1;
+    }
+    if (sim_pages_left > 0)
+        sim_pages_left--;
+    memcpy(sim_flash + page * FLASH_PAGE / 4, data, FLASH_PAGE);
+    sim_us += SIM_PAGE_US;
+    return 0;
+}
+
+const uint32_t *boot_app(void)
+{
+    return sim_flash;
+}
+
+void boot_run(void)
+{
+    sim_run = 1;
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static uint32_t crc_bytes(const uint8_t *p, uint32_t len)
+{
+    static uint32_t words[APP_SIZE / 4];
+    uint32_t i;
+
+    for (i = 0; i < len / 4; i++)
+        words[i] = get32(p + 4 * i);
+    return boot_crc(words, len / 4);
+}
+
+/* one command and the status read after it */
+static int command(const uint8_t *tx, int len, uint32_t *value, useconds_t wait)
+{
+    uint8_t rx[5];
+
+    bus_bytes += 1 + len + 1 + sizeof(rx);
+    if (sim_file)
+    {
+        rx[0] = Boot_Command(tx, len, value);
+        sim_us += (1 + len + 1 + sizeof(rx)) * 9 * 1000000ul / SIM_BUS_HZ;
+        return rx[0];
+    }
+
+    if (write(bus, tx, len) != len)
+        return -1;
+    if (wait)
+        usleep(wait);
+    if (read(bus, rx, sizeof(rx)) != sizeof(rx))
+        return -1;
+    *value = get32(rx + 1);
+    return rx[0];
+}
+
+/* greedy LZSS of one page in the format of boot.h, returns its length */
+static int compress(const uint8_t *in, uint8_t *out)
+{
+    int pos = 0, len = 0, flags = 0, item = 8;
+    int best, dist, n, i;
+
+    while (pos < FLASH_PAGE)
+    {
+        if (item == 8)
+        {
+            flags = len++;
+            out[flags] = 0;
+            item = 0;
+        }
+
+        best = dist = 0;
+        for (i = pos > LZ_WINDOW ? pos - LZ_WINDOW : 0; i < pos; i++)
+        {
+            for (n = 0; n < LZ_MAX && pos + n < FLASH_PAGE && in[i + n] == in[pos + n]; n++)
+                ;
+            if (n >= best)
+            {
+                best = n;
+                dist = pos - i;
+            }
+        }
+
+        if (best >= LZ_MIN)
+        {
+            n = (dist - 1) << 6 | (best - LZ_MIN);
+            out[len++] = n;
+            out[len++] = n >> 8;
+            pos += best;
+        }
+        else
+        {
+            out[flags] |= 1 << item;
+            out[len++] = in[pos++];
+        }
+        item++;
+    }
+    return len;
+}
+
+static int send_frame(uint8_t *tx, int chunk, const uint8_t *data)
+{
+    uint32_t value;
+    int try, rc = -1;
+
+    tx[1] = chunk;
+    memcpy(tx + 2, data, BOOT_BLOCK);
+    put32(tx + 2 + BOOT_BLOCK, crc_bytes(data, BOOT_BLOCK));
+    for (try = 0; try < RETRIES; try++)
+        if ((rc = command(tx, BOOT_FRAME, &value, 0)) == BOOT_OK)
+            break;
+    return rc;
+}
+
+static int send_page(int page)
+{
+    const uint8_t *data = image + page * FLASH_PAGE;
+    uint8_t z[FLASH_PAGE * 9 / 8 + BOOT_BLOCK];
+    uint8_t tx[BOOT_FRAME];
+    uint32_t value;
+    int block, chunks = BOOT_BLOCKS, rc;
+
+    if (zload)
+    {
+        memset(z, 0, sizeof(z));
+        chunks = (compress(data, z) + BOOT_BLOCK - 1) / BOOT_BLOCK;
+        if (chunks > BOOT_BLOCKS)       /* did not compress, send it raw */
+            chunks = BOOT_BLOCKS;
+    }
+
+    page_bytes += FLASH_PAGE;
+    sent_bytes += chunks * BOOT_BLOCK;
+    tx[0] = chunks < BOOT_BLOCKS ? BOOT_CMD_ZLOAD : BOOT_CMD_LOAD;
+    for (block = 0; block < chunks; block++)
+    {
+        rc = send_frame(tx, block, (tx[0] == BOOT_CMD_ZLOAD ? z : data) + block * BOOT_BLOCK);
+        if (rc != BOOT_OK)
+            return rc;
+    }
+
+    tx[0] = BOOT_CMD_WRITE;
+    tx[1] = page;
+    put32(tx + 2, crc_bytes(data, FLASH_PAGE));
+    return command(tx, 6, &value, WRITE_WAIT_US);
+}
+
+static int make_image(const char *in, const char *out)
+{
+    FILE *f = fopen(in, "rb");
+    size_t len;
+
+    if (!f)
+    {
+        perror(in);
+        return 1;
+    }
+    memset(image, 0xff, sizeof(image));
+    len = fread(image, 1, sizeof(image), f);
+    if (!feof(f) || len > APP_SIZE - 4)
+    {
+        fprintf(stderr, "%s: larger than %d bytes\n", in, APP_SIZE - 4);
+        fclose(f);
+        return 1;
+    }
+    fclose(f);
+
+    put32(image + APP_SIZE - 4, crc_bytes(image, APP_SIZE - 4));
+
+    f = fopen(out, "wb");
+    if (!f || fwrite(image, 1, sizeof(image), f) != sizeof(image))
+    {
+        perror(out);
+        return 1;
+    }
+    fclose(f);
+    return 0;
+}
+
+static int open_target(int bus_nr, int addr)
+{
+    static const uint8_t enter[4] = { 0xf0, 'B', 'O', 'T' };
+    uint8_t info = BOOT_CMD_INFO;
+    uint32_t value = 0;
+    char path[32];
+    FILE *f;
+
+    if (sim_file)
+    {
+        memset(sim_flash, 0xff, sizeof(sim_flash));
+        f = fopen(sim_file, "rb");
+        if (f)
+        {
+            if (fread(sim_flash, 1, sizeof(sim_flash), f) != sizeof(sim_flash))
+                fprintf(stderr, "%s: short, rest erased\n", sim_file);
+            fclose(f);
+        }
+    }
+    else
+    {
+        snprintf(path, sizeof(path), "/dev/i2c-%d", bus_nr);
+        bus = open(path, O_RDWR);
+        if (bus < 0 || ioctl(bus, I2C_SLAVE, addr) < 0)
+        {
+            perror(path);
+            return -1;
+        }
+        /* the application resets into the bootloader, the bootloader ignores it */
+        if (write(bus, enter, sizeof(enter)) == sizeof(enter))
+            usleep(100000);
+    }
+
+    if (command(&info, 1, &value, 0) != BOOT_OK ||
+        (value & 0xffff) != FLASH_PAGE || ((value >> 16) & 0xff) != APP_PAGES)
+    {
+        fprintf(stderr, "no bootloader with a matching layout (info %08x)\n", (unsigned)value);
+        return -1;
+    }
+    if (value >> 24 < 2)
+        zload = 0;
+    return 0;
+}
+
+static void close_target(void)
+{
+    FILE *f;
+
+    if (!sim_file)
+    {
+        close(bus);
+        return;
+    }
+    f = fopen(sim_file, "wb");
+    if (!f || fwrite(sim_flash, 1, sizeof(sim_flash), f) != sizeof(sim_flash))
+        perror(sim_file);
+    if (f)
+        fclose(f);
+}
+
+static int upload(const char *file, int bus_nr, int addr)
+{
+    FILE *f = fopen(file, "rb");
+    struct timespec t0, t1;
+    uint8_t tx[2];
+    uint32_t value;
+    int page, written = 0, rc = 0;
+    double s;
+
+    if (!f || fread(image, 1, sizeof(image), f) != sizeof(image))
+    {
+        fprintf(stderr, "%s: not a %d byte image, see -m\n", file, APP_SIZE);
+        return 1;
+    }
+    fclose(f);
+
+    if (open_target(bus_nr, addr))
+        return 1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    for (page = 0; page < APP_PAGES; page++)
+    {
+        tx[0] = BOOT_CMD_CRC;
+        tx[1] = page;
+        if (command(tx, 2, &value, 0) == BOOT_OK && value == crc_bytes(image + page * FLASH_PAGE, FLASH_PAGE))
+            continue;
+        if ((rc = send_page(page)) != BOOT_OK)
+        {
+            fprintf(stderr, "page %d: status %d\n", page, rc);
+            break;
+        }
+        written++;
+    }
+
+    if (rc == BOOT_OK)
+    {
+        tx[0] = BOOT_CMD_RUN;
+        if ((rc = command(tx, 1, &value, 0)) != BOOT_OK)
+            fprintf(stderr, "run: status %d\n", rc);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    s = sim_file ? sim_us / 1e6 : (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    printf("%d of %d pages written, %lu bus bytes in %.2f s%s, %.0f image bytes/s\n",
+        written, APP_PAGES, bus_bytes, s, sim_file ? " at 100 kHz" : "",
+        s > 0 ? written * FLASH_PAGE / s : 0.0);
+    if (page_bytes)
+        printf("%lu page bytes sent as %lu, %.0f%%\n",
+            page_bytes, sent_bytes, 100.0 * sent_bytes / page_bytes);
+    if (sim_file && rc == BOOT_OK)
+        printf("simulated target %s\n", sim_run ? "started the image" : "did not start");
+
+    close_target();
+    return rc != BOOT_OK;
+}
+
+int main(int argc, char **argv)
+{
+    int bus_nr = 1, addr = 0x2d, opt;
+    const char *bin = NULL;
+
+    zload = 1;
+    while ((opt = getopt(argc, argv, "b:a:s:x:m:u")) != -1)
+    {
+        switch (opt)
+        {
+            case 'b': bus_nr = atoi(optarg); break;
+            case 'a': addr = strtol(optarg, NULL, 0); break;
+            case 's': sim_file = optarg; break;
+            case 'x': sim_pages_left = atoi(optarg); break;
+            case 'm': bin = optarg; break;
+            case 'u': zload = 0; break;
+            default:
+                fprintf(stderr, "usage: %s [-b bus] [-a addr] [-u] [-s sim.bin [-x pages]] image\n"
+                    "       %s -m app.bin image\n", argv[0], argv[0]);
+                return 1;
+        }
+    }
+    if (optind != argc - 1)
+    {
+        fprintf(stderr, "%s: image file missing\n", argv[0]);
+        return 1;
+    }
+
+    if (bin)
+        return make_image(bin, argv[optind]);
+    return upload(argv[optind], bus_nr, addr);
+}
@@ -0,0 +1,135 @@
+/*
+ * Host test of src/sched.c, the tick is a loop counter.
+ *
+ *   sched_test
+ *       periodic timers at and above the wheel size, one shot
+ *       timers across the wheel wrap, re-armed and re-armed from their own
+ *       task, and the load figure; prints each failure and exits non-zero
+ *       if there was one
+ *
+ * Every tick is followed by a dispatch, as the main loop does when it
+ * keeps up, so a task sees the tick its event was posted on.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "sched.h"
+
+#define RUN_TICKS               1000
+
+#define EV_P8                   0
+#define EV_P13                  1
+#define EV_ONCE                 2
+#define EV_SELF                 3
+
+static unsigned count[SCHED_EVENTS];
+static uint32_t last[SCHED_EVENTS];
+static int bad[SCHED_EVENTS];
+static uint16_t period[SCHED_EVENTS] = { 8, 13 };
+static int failed;
+
+static void check(int ok, const char *what, uint32_t now)
+{
+    if (ok)
+        return;
+    printf("tick %u: %s\n", (unsigned)now, what);
+    failed++;
+}
+
+static void periodic(uint8_t ev)
+{
+    uint32_t now = Sched_Now();
+
+    if (now % period[ev] != 0 || (count[ev] && now - last[ev] != period[ev]))
+        bad[ev]++;
+    count[ev]++;
+    last[ev] = now;
+}
+
+static void p8(void) { periodic(EV_P8); }
+static void p13(void) { periodic(EV_P13); }
+
+static void once(void)
+{
+    count[EV_ONCE]++;
+    last[EV_ONCE] = Sched_Now();
+}
+
+/* re-arms itself with a growing delay, 1 .. 20 ticks */
+static void self(void)
+{
+    uint32_t now = Sched_Now();
+
+    if (count[EV_SELF] && now - last[EV_SELF] != count[EV_SELF])
+        bad[EV_SELF]++;
+    count[EV_SELF]++;
+    last[EV_SELF] = now;
+    if (count[EV_SELF] <= 20)
+        Sched_After(EV_SELF, count[EV_SELF]);
+}
+
+static void run(uint32_t ticks, uint32_t idle)
+{
+    while (ticks--)
+    {
+        Sched_Idle(idle);
+        Sched_Tick();
+        Sched_Dispatch();
+    }
+}
+
+int main(void)
+{
+    uint32_t t0;
+    int ev;
+
+    Sched_Task(EV_P8, p8);
+    Sched_Task(EV_P13, p13);
+    Sched_Task(EV_ONCE, once);
+    Sched_Task(EV_SELF, self);
+    Sched_Every(EV_P8, 8);
+    Sched_Every(EV_P13, 13);
+    Sched_Set_Clock(100);
+
+    /* first load window at 25 % idle */
+    run(RUN_TICKS, 25);
+    for (ev = EV_P8; ev <= EV_P13; ev++)
+    {
+        check(count[ev] == RUN_TICKS / period[ev], "periodic count", Sched_Now());
+        check(!bad[ev], "periodic timing", Sched_Now());
+    }
+    check(Sched_Load() == 750, "load", Sched_Now());
+
+    /* one shot beyond the wheel, fires once */
+    t0 = Sched_Now();
+    Sched_After(EV_ONCE, 21);
+    run(40, 0);
+    check(count[EV_ONCE] == 1 && last[EV_ONCE] == t0 + 21, "one shot", Sched_Now());
+
+    /* armed again before it is due, only the second counts */
+    t0 = Sched_Now();
+    Sched_After(EV_ONCE, 5);
+    run(3, 0);
+    Sched_After(EV_ONCE, 12);
+    run(30, 0);
+    check(count[EV_ONCE] == 2 && last[EV_ONCE] == t0 + 3 + 12, "re-armed one shot", Sched_Now());
+
+    /* zero delay is the next tick */
+    t0 = Sched_Now();
+    Sched_After(EV_ONCE, 0);
+    run(2, 0);
+    check(count[EV_ONCE] == 3 && last[EV_ONCE] == t0 + 1, "zero delay", Sched_Now());
+
+    /* from its own task, the periodic timers keep their pace meanwhile;
+     * runs into a whole load window at 100 % idle */
+    Sched_After(EV_SELF, 1);
+    run(2 * RUN_TICKS, 100);
+    check(count[EV_SELF] == 21 && !bad[EV_SELF], "self re-arm", Sched_Now());
+    for (ev = EV_P8; ev <= EV_P13; ev++)
+        check(!bad[ev], "periodic timing with one shots", Sched_Now());
+    check(Sched_Load() == 0, "idle load", Sched_Now());
+
+    printf("sched_test: %s\n", failed ? "FAILED" : "ok");
+    return failed != 0;
+}
@@ -0,0 +1,256 @@
+/*
+ * Host side of the UART transport, see src/frame.c and uart_task() in
+ * src/main.c.
+ *
+ *   uart_test [-d /dev/ttyUSB0] [-n packets]
+ *       sends packets of four commands, set param, get param, set param
+ *       and get param of the gear ratio (id 0x09), checks that the replies
+ *       echo both values and reports the command rate
+ *
+ * Without -d the shield is simulated on a pseudo terminal: a child process
+ * feeds the bytes through the same frame.c and answers set and get param
+ * from a table, so framing, resynchronisation and the tool can be tried
+ * without hardware. Every 16th packet is preceded by a copy with a damaged
+ * value byte, which must be dropped for its CRC.
+ *
+ * The gear ratio takes any 16 bit value and does nothing while gearing is
+ * off. A real shield with gearing on is left alone, otherwise its ratio
+ * is restored at the end.
+ */
+
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 600
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <termios.h>
+#include <sys/wait.h>
+
+#include "frame.h"
+#include "uart.h"
+#include "param.h"
+
+#define PARAM_ID                PARAM_GEAR_RATIO
+#define REPLY_MS                100
+
+static int fd = -1;
+
+static int raw(int f, speed_t baud)
+{
+    struct termios t;
+
+    if (tcgetattr(f, &t))
+        return -1;
+    cfmakeraw(&t);
+    cfsetispeed(&t, baud);
+    cfsetospeed(&t, baud);
+    t.c_cc[VMIN] = 1;
+    t.c_cc[VTIME] = 0;
+    return tcsetattr(f, TCSANOW, &t);
+}
+
+static int send_all(int f, const uint8_t *p, int len)
+{
+    int n;
+
+    while (len > 0)
+    {
+        if ((n = write(f, p, len)) <= 0)
+            return -1;
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/* the simulated shield, params per motor and id, replies as user_i2c.c does */
+static void target(int f)
+{
+    static uint16_t param[3][256];
+    uint8_t buf[64], reply[FRAME_MAX], pkt[FRAME_SIZE(FRAME_MAX)];
+    uint8_t *cmd;
+    int n, i, len, k;
+
+    while ((n = read(f, buf, sizeof(buf))) > 0)
+    {
+        for (i = 0; i < n; i++)
+        {
+            len = Frame_Rx(buf[i]);
+            if (len == 0 || (len & 3))
+                continue;
+            cmd = Frame_Payload();
+            for (k = 0; k < len; k += 4)
+            {
+                uint8_t m = cmd[k] & 0x03;
+
+                if ((cmd[k] >> 4) == 2 && m < 3)
+                    param[m][cmd[k + 1]] = cmd[k + 2] << 8 | cmd[k + 3];
+                if ((cmd[k] >> 4) == 5 && m < 3)
+                {
+                    reply[k] = 0;
+                    reply[k + 1] = 0;
+                    reply[k + 2] = param[m][cmd[k + 1]] >> 8;
+                    reply[k + 3] = param[m][cmd[k + 1]];
+                }
+                else if (k)
+                    memcpy(reply + k, reply + k - 4, 4);
+                else
+                    memset(reply, 0, 4);
+            }
+            if (send_all(f, pkt, Frame_Pack(pkt, reply, len)))
+                return;
+        }
+    }
+}
+
+/* waits for one reply packet, returns its length or -1 on timeout */
+static int receive(uint8_t *payload)
+{
+    struct pollfd p = { fd, POLLIN, 0 };
+    uint8_t b;
+    int len;
+
+    while (poll(&p, 1, REPLY_MS) > 0)
+    {
+        if (read(fd, &b, 1) != 1)
+            return -1;
+        if ((len = Frame_Rx(b)) != 0)
+        {
+            memcpy(payload, Frame_Payload(), len);
+            return len;
+        }
+    }
+    return -1;
+}
+
+static int exchange(const uint8_t *cmd, int len, uint8_t *reply, int corrupt)
+{
+    uint8_t pkt[FRAME_SIZE(FRAME_MAX)];
+    int n = Frame_Pack(pkt, cmd, len);
+
+    /* a reply to the damaged copy would carry the wrong value */
+    if (corrupt)
+    {
+        pkt[4] ^= 0x55;
+        if (send_all(fd, pkt, n))
+            return -1;
+        pkt[4] ^= 0x55;
+    }
+    if (send_all(fd, pkt, n))
+        return -1;
+    return receive(reply) == len ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+    const char *dev = NULL;
+    int packets = 1000, opt, i, errors = 0;
+    pid_t child = 0;
+    struct timespec t0, t1;
+    uint8_t saved[8];
+    double s;
+
+    while ((opt = getopt(argc, argv, "d:n:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'd': dev = optarg; break;
+            case 'n': packets = atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-d tty] [-n packets]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (dev)
+    {
+        fd = open(dev, O_RDWR | O_NOCTTY);
+        if (fd < 0 || raw(fd, B1000000))
+        {
+            perror(dev);
+            return 1;
+        }
+    }
+    else
+    {
+        int master = posix_openpt(O_RDWR | O_NOCTTY);
+
+        if (master < 0 || grantpt(master) || unlockpt(master) ||
+            (fd = open(ptsname(master), O_RDWR | O_NOCTTY)) < 0 || raw(fd, B1000000))
+        {
+            perror("pty");
+            return 1;
+        }
+        if ((child = fork()) == 0)
+        {
+            close(fd);
+            target(master);
+            _exit(0);
+        }
+        printf("simulated shield on %s\n", ptsname(master));
+        close(master);
+    }
+
+    if (dev)
+    {
+        uint8_t cmd[8] = { 0x50, PARAM_GEAR_ENABLE, 0, 0, 0x50, PARAM_ID, 0, 0 };
+
+        if (exchange(cmd, sizeof(cmd), saved, 0))
+        {
+            fprintf(stderr, "%s: no reply\n", dev);
+            return 1;
+        }
+        if (saved[3])
+        {
+            fprintf(stderr, "%s: gearing is on, the test would drive motor B\n", dev);
+            return 1;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < packets; i++)
+    {
+        uint16_t v = i * 7, nv = ~v;
+        uint8_t cmd[16] = {
+            0x20, PARAM_ID, v >> 8, v,
+            0x50, PARAM_ID, 0, 0,
+            0x20, PARAM_ID, nv >> 8, nv,
+            0x50, PARAM_ID, 0, 0,
+        };
+        uint8_t reply[FRAME_MAX];
+
+        if (exchange(cmd, sizeof(cmd), reply, !dev && (i & 15) == 15) ||
+            (reply[6] << 8 | reply[7]) != v || (reply[14] << 8 | reply[15]) != nv)
+            errors++;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    if (dev)
+    {
+        uint8_t cmd[4] = { 0x20, PARAM_ID, saved[6], saved[7] }, reply[4];
+
+        if (exchange(cmd, sizeof(cmd), reply, 0))
+            fprintf(stderr, "%s: gear ratio not restored\n", dev);
+    }
+
+    s = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    printf("%d packets, %d commands, %d errors in %.2f s, %.0f commands/s\n",
+        packets, 4 * packets, errors, s, s > 0 ? 4 * packets / s : 0.0);
+    if (dev)
+        printf("%d bytes per packet, %.0f commands/s at the line limit of %d baud\n",
+            FRAME_SIZE(16), UART_BAUD / 10.0 / FRAME_SIZE(16) * 4, UART_BAUD);
+
+    close(fd);
+    if (child)
+    {
+        kill(child, SIGTERM);
+        waitpid(child, NULL, 0);
+    }
+    return errors != 0;
+}